@@ -0,0 +1,184 @@
+"""
+Wired receiver frame protocol on the native_sim pty
+
+Runs zephyr.exe (prj_native_sim.conf) under twister, opens the pty it
+prints and checks the framing of src/receiver.c in both directions:
+RECEIVER_SYNC, length, type, payload, CRC-8 (CCITT, initial value 0, over
+length, type and payload). The constants mirror src/config.h, receiver.h
+and press_event.h.
+"""
+
+import os
+import re
+import select
+import struct
+import time
+import tty
+
+import pytest
+
+RECEIVER_SYNC = 0xA5
+RECEIVER_MAX_PAYLOAD = 48
+
+RECEIVER_FRAME_EVENT = 0x01
+RECEIVER_FRAME_PONG = 0x03
+RECEIVER_FRAME_GAME_STATE = 0x81
+RECEIVER_FRAME_PING = 0x82
+RECEIVER_FRAME_PRESS = 0x83
+
+PRESS_EVENT_VERSION = 1
+PRESS_EVENT_TYPE_PRESS = 1
+PRESS_EVENT_FLAG_TIMESTAMP = 0x01
+
+# struct press_event_record, little-endian and packed
+RECORD = struct.Struct('<BBHBBIIIHHBbIH')
+
+TIMEOUT_S = 2.0
+
+
+def crc8_ccitt(data, crc=0):
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def frame(frame_type, payload=b''):
+    body = bytes([len(payload), frame_type]) + payload
+    return bytes([RECEIVER_SYNC]) + body + bytes([crc8_ccitt(body)])
+
+
+class Pty:
+    """Raw pty of the receiver UART, with a frame parser for the host side"""
+
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        self.buf = b''
+
+    def close(self):
+        os.close(self.fd)
+
+    def write(self, data):
+        os.write(self.fd, data)
+
+    def _fill(self, deadline):
+        remaining = deadline - time.monotonic()
+        if remaining <= 0:
+            return False
+        ready, _, _ = select.select([self.fd], [], [], remaining)
+        if ready:
+            self.buf += os.read(self.fd, 256)
+        return True
+
+    def read_frame(self, timeout=TIMEOUT_S):
+        """Next frame as (type, payload), None on timeout; checks sync, length and CRC"""
+        deadline = time.monotonic() + timeout
+        while True:
+            if self.buf:
+                assert self.buf[0] == RECEIVER_SYNC, f'no sync byte: {self.buf.hex()}'
+            if len(self.buf) >= 2:
+                assert self.buf[1] <= RECEIVER_MAX_PAYLOAD, f'length {self.buf[1]}'
+                size = self.buf[1] + 4
+                if len(self.buf) >= size:
+                    raw, self.buf = self.buf[:size], self.buf[size:]
+                    assert crc8_ccitt(raw[1:-1]) == raw[-1], f'bad CRC: {raw.hex()}'
+                    return raw[2], raw[3:-1]
+            if not self._fill(deadline):
+                return None
+
+
+@pytest.fixture
+def pty(dut):
+    lines = dut.readlines_until(regex=r'connected to pseudotty: /dev/pts/\d+', timeout=10)
+    path = re.search(r'(/dev/pts/\d+)', lines[-1]).group(1)
+    dut.readlines_until(regex='Wired receiver ready', timeout=10)
+
+    port = Pty(path)
+    yield port
+    port.close()
+
+
+def ping(pty, token):
+    pty.write(frame(RECEIVER_FRAME_PING, struct.pack('<I', token)))
+
+
+def test_crc8_reference():
+    # CRC-8/CCITT check value (poly 0x07, initial value 0, no reflection)
+    assert crc8_ccitt(b'123456789') == 0xF4
+
+
+def test_ping_answered_with_pong(pty):
+    ping(pty, 0x12345678)
+
+    received = pty.read_frame()
+    assert received is not None, 'no pong'
+    frame_type, payload = received
+    assert frame_type == RECEIVER_FRAME_PONG
+    assert len(payload) == 8
+    token, _receiver_us = struct.unpack('<II', payload)
+    assert token == 0x12345678
+
+
+def test_press_frames(pty):
+    round_id = 0x0102
+    pty.write(frame(RECEIVER_FRAME_GAME_STATE, struct.pack('<BHB', 1, round_id, 0)))
+    pty.write(frame(RECEIVER_FRAME_PRESS, bytes([7, 3])))
+
+    seqs = []
+    for _ in range(3):
+        received = pty.read_frame()
+        assert received is not None, f'{len(seqs)} of 3 event frames'
+        frame_type, payload = received
+        assert frame_type == RECEIVER_FRAME_EVENT
+        assert len(payload) == 1 + RECORD.size
+        assert payload[0] == 7
+
+        (version, event_type, seq, _button, flags, _edge_us, _conn_event,
+         _anchor_offset_us, _interval, _age_ms, _phy, _rssi, _reaction_us,
+         event_round) = RECORD.unpack(payload[1:])
+        assert version == PRESS_EVENT_VERSION
+        assert event_type == PRESS_EVENT_TYPE_PRESS
+        assert flags & PRESS_EVENT_FLAG_TIMESTAMP
+        assert event_round == round_id
+        seqs.append(seq)
+
+    assert seqs == [(seqs[0] + i) & 0xFFFF for i in range(3)]
+
+
+def test_bad_crc_dropped(pty):
+    bad = bytearray(frame(RECEIVER_FRAME_PING, struct.pack('<I', 1)))
+    bad[-1] ^= 0xFF
+    pty.write(bytes(bad))
+    ping(pty, 2)
+
+    received = pty.read_frame()
+    assert received is not None, 'no pong'
+    frame_type, payload = received
+    assert frame_type == RECEIVER_FRAME_PONG
+    assert struct.unpack('<I', payload[:4])[0] == 2
+    assert pty.read_frame(timeout=0.2) is None
+
+
+def test_oversize_length_resyncs(pty):
+    # A length above RECEIVER_MAX_PAYLOAD is not a frame; the parser looks
+    # for the next sync byte
+    pty.write(bytes([RECEIVER_SYNC, RECEIVER_MAX_PAYLOAD + 1]))
+    ping(pty, 3)
+
+    received = pty.read_frame()
+    assert received is not None, 'no pong after oversize length'
+    frame_type, payload = received
+    assert frame_type == RECEIVER_FRAME_PONG
+    assert struct.unpack('<I', payload[:4])[0] == 3
+
+
+def test_noise_before_sync(pty):
+    pty.write(bytes([0x00, 0xFF, 0x42]))
+    ping(pty, 4)
+
+    received = pty.read_frame()
+    assert received is not None, 'no pong after noise'
+    assert received[0] == RECEIVER_FRAME_PONG
+    assert struct.unpack('<I', received[1][:4])[0] == 4
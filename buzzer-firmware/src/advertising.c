@@ -0,0 +1,451 @@
+/**
+ * Advertising and reconnect implementation
+ * 
+ * Advertising is restarted from the connection object's recycled callback,
+ * the earliest point where the single connection slot is free again, and
+ * steps through its stages on the system workqueue. The high duty cycle
+ * directed stage only reaches a central that is actively initiating (e.g. a
+ * browser calling gatt.connect() again, or an OS auto-reconnect) and that
+ * knows this buzzer's address; everyone else finds it through the following
+ * undirected stages.
+ * 
+ * Bonds (one central, CONFIG_BT_MAX_PAIRED) are stored by the Bluetooth
+ * host through the settings subsystem. A new central replaces the bond.
+ * Pairing is Just Works unless the central asks for MITM protection, which
+ * the Identity write makes it do: then the central types the fixed
+ * CONFIG_BUZZER_IDENTITY_PASSKEY (display-only, nothing is displayed).
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "config.h"
+#include "advertising.h"
+#include "identity.h"
+#include "battery.h"
+#include "hub.h"
+
+LOG_MODULE_REGISTER(advertising, BUZZER_LOG_LEVEL);
+
+/* Fallback end of the directed stage, in case the controller's timeout
+ * (1.28 s) is not reported
+ */
+#define ADV_DIRECTED_FALLBACK_MS  1500
+
+enum adv_stage {
+    ADV_STAGE_DIRECTED,
+    ADV_STAGE_FAST,
+    ADV_STAGE_NORMAL,
+    ADV_STAGE_SLOW,
+    ADV_STAGE_NONE,     /* Not advertising */
+};
+
+static const char *const stage_names[] = {"directed", "fast", "normal", "slow", "none"};
+
+/* Manufacturer data: company ID (2, little-endian), version, buzzer ID,
+ * battery level (%), ADV_MFR_FLAG_*
+ */
+static uint8_t mfr_data[6];
+
+/* Advertising data: 3 + 18 + 8 = 29 of 31 bytes, the name goes in the scan response */
+static const struct bt_data ad[] = {
+    BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+    BT_DATA_BYTES(BT_DATA_UUID128_ALL, BT_UUID_BUZZER_SERVICE_VAL),
+    BT_DATA(BT_DATA_MANUFACTURER_DATA, mfr_data, sizeof(mfr_data)),
+};
+
+static bool ready;
+
+static enum adv_stage stage = ADV_STAGE_NONE;
+
+/* Bonded central, target of the directed stage */
+static bt_addr_le_t bond_addr;
+static bool bonded;
+
+/* Set on link loss, advertising restarts once the connection is recycled */
+static bool restart_pending;
+
+/* Reconnect timing */
+static int64_t link_lost_ms;      /* Uptime of the link loss, 0 = none */
+static struct reconnect_stats stats;
+static uint64_t total_ms;
+static const uint32_t bucket_limits[ADV_RECONNECT_BUCKETS] = ADV_RECONNECT_BUCKET_LIMITS_MS;
+
+/* Reconnect test (ADV_RECONNECT_TEST_CYCLES) */
+static struct bt_conn *test_conn;
+static uint32_t test_cycles;
+
+static struct k_work_delayable stage_work;
+static struct k_work restart_work;
+static struct k_work_delayable test_work;
+
+static int start_stage(enum adv_stage next)
+{
+    struct bt_le_adv_param param = {
+        .id = BT_ID_DEFAULT,
+        .options = BT_LE_ADV_OPT_CONN | BT_LE_ADV_OPT_USE_NAME,
+    };
+    int err;
+
+    switch (next) {
+    case ADV_STAGE_DIRECTED:
+        /* High duty cycle: no advertising data and no interval */
+        param.options = BT_LE_ADV_OPT_CONN;
+        param.peer = &bond_addr;
+        err = bt_le_adv_start(&param, NULL, 0, NULL, 0);
+        if (err) {
+            LOG_WRN("Directed advertising failed (err %d)", err);
+            return start_stage(ADV_STAGE_FAST);
+        }
+        k_work_reschedule(&stage_work, K_MSEC(ADV_DIRECTED_FALLBACK_MS));
+        break;
+    case ADV_STAGE_FAST:
+        param.interval_min = ADV_FAST_INTERVAL_MIN;
+        param.interval_max = ADV_FAST_INTERVAL_MAX;
+        err = bt_le_adv_start(&param, ad, ARRAY_SIZE(ad), NULL, 0);
+        k_work_reschedule(&stage_work, K_MSEC(ADV_FAST_DURATION_MS));
+        break;
+    case ADV_STAGE_NORMAL:
+        param.interval_min = ADV_INTERVAL_MIN;
+        param.interval_max = ADV_INTERVAL_MAX;
+        err = bt_le_adv_start(&param, ad, ARRAY_SIZE(ad), NULL, 0);
+        k_work_reschedule(&stage_work, K_MSEC(ADV_NORMAL_DURATION_MS));
+        break;
+    default:
+        next = ADV_STAGE_SLOW;
+        param.interval_min = ADV_SLOW_INTERVAL_MIN;
+        param.interval_max = ADV_SLOW_INTERVAL_MAX;
+        err = bt_le_adv_start(&param, ad, ARRAY_SIZE(ad), NULL, 0);
+        break;
+    }
+
+    if (err == -EALREADY) {
+        LOG_INF("Advertising already active");
+        return 0;
+    }
+    if (err) {
+        LOG_ERR("Advertising failed to start (err %d)", err);
+        k_work_cancel_delayable(&stage_work);
+        stage = ADV_STAGE_NONE;
+        return err;
+    }
+
+    stage = next;
+    LOG_INF("Advertising started (%s)", stage_names[stage]);
+    return 0;
+}
+
+/* Stage work handler - move on to the next, slower stage */
+static void stage_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    if (stage == ADV_STAGE_NONE || stage == ADV_STAGE_SLOW) {
+        return;
+    }
+
+    bt_le_adv_stop();
+    start_stage(stage + 1);
+}
+
+/* Restart work handler - advertise again after a link loss */
+static void restart_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    if (!restart_pending) {
+        return;
+    }
+    restart_pending = false;
+    advertising_start();
+}
+
+int advertising_start(void)
+{
+    return start_stage(bonded ? ADV_STAGE_DIRECTED : ADV_STAGE_FAST);
+}
+
+static void build_mfr_data(void)
+{
+    uint8_t level = battery_get_level();
+    uint8_t flags = 0;
+
+    if (ready) {
+        flags |= ADV_MFR_FLAG_READY;
+    }
+    if (bonded) {
+        flags |= ADV_MFR_FLAG_BONDED;
+    }
+    if (level < LED_LOW_BATTERY_THRESHOLD) {
+        flags |= ADV_MFR_FLAG_LOW_BATTERY;
+    }
+
+    sys_put_le16(ADV_MFR_COMPANY_ID, &mfr_data[0]);
+    mfr_data[2] = ADV_MFR_DATA_VERSION;
+    mfr_data[3] = identity_get()->id;
+    mfr_data[4] = level;
+    mfr_data[5] = flags;
+}
+
+void advertising_update_data(void)
+{
+    int err;
+
+    build_mfr_data();
+
+    /* Directed advertising carries no data, the next stage picks it up */
+    if (stage == ADV_STAGE_NONE || stage == ADV_STAGE_DIRECTED) {
+        return;
+    }
+
+    err = bt_le_adv_update_data(ad, ARRAY_SIZE(ad), NULL, 0);
+    if (err) {
+        LOG_WRN("Failed to update advertising data (err %d)", err);
+    }
+}
+
+void advertising_set_ready(bool is_ready)
+{
+    ready = is_ready;
+    advertising_update_data();
+}
+
+static void log_reconnect_stats(void)
+{
+    LOG_INF("Reconnect times: n=%u (directed %u) min=%ums avg=%ums max=%ums",
+            stats.count, stats.directed, stats.min_ms, stats.avg_ms, stats.max_ms);
+    LOG_INF("  <=100ms:%u <=250ms:%u <=500ms:%u <=1s:%u <=2s:%u <=5s:%u <=10s:%u >10s:%u",
+            stats.buckets[0], stats.buckets[1], stats.buckets[2], stats.buckets[3],
+            stats.buckets[4], stats.buckets[5], stats.buckets[6], stats.buckets[7]);
+}
+
+static void record_reconnect(uint32_t ms, bool directed)
+{
+    if (stats.count == 0 || ms < stats.min_ms) {
+        stats.min_ms = ms;
+    }
+    stats.max_ms = MAX(stats.max_ms, ms);
+    stats.count++;
+    stats.directed += directed;
+    total_ms += ms;
+    stats.avg_ms = total_ms / stats.count;
+
+    for (int i = 0; i < ADV_RECONNECT_BUCKETS; i++) {
+        if (ms <= bucket_limits[i]) {
+            stats.buckets[i]++;
+            break;
+        }
+    }
+
+    LOG_INF("Reconnected in %u ms (%s advertising)", ms, directed ? "directed" : "undirected");
+    if (stats.count % 10 == 0) {
+        log_reconnect_stats();
+    }
+}
+
+void advertising_get_reconnect_stats(struct reconnect_stats *out)
+{
+    *out = stats;
+}
+
+/* Test work handler - force a disconnect for the reconnect test */
+static void test_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    if (test_conn) {
+        LOG_INF("Reconnect test: disconnect %u/%u", test_cycles + 1, ADV_RECONNECT_TEST_CYCLES);
+        test_cycles++;
+        bt_conn_disconnect(test_conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+    }
+}
+
+static void adv_connected(struct bt_conn *conn, uint8_t err)
+{
+    bool directed = (stage == ADV_STAGE_DIRECTED);
+
+    if (hub_is_buzzer_link(conn)) {
+        return;
+    }
+
+    if (err == BT_HCI_ERR_ADV_TIMEOUT) {
+        /* Directed burst over, nobody answered */
+        k_work_reschedule(&stage_work, K_NO_WAIT);
+        return;
+    }
+
+    if (err) {
+        restart_pending = true;
+        k_work_submit(&restart_work);
+        return;
+    }
+
+    k_work_cancel_delayable(&stage_work);
+    stage = ADV_STAGE_NONE;
+
+    if (link_lost_ms) {
+        record_reconnect(k_uptime_get() - link_lost_ms, directed);
+        link_lost_ms = 0;
+    }
+
+    if (IS_ENABLED(CONFIG_BUZZER_BONDING)) {
+        /* A different central only replaces the bond once its own pairing
+         * completes (pairing_complete()), so a stray connection does not
+         * cost the game host its bond
+         */
+        int sec_err = bt_conn_set_security(conn, BT_SECURITY_L2);
+        if (sec_err) {
+            LOG_WRN("Failed to request bonding (err %d)", sec_err);
+        }
+    }
+
+    if (ADV_RECONNECT_TEST_CYCLES > 0 && test_cycles < ADV_RECONNECT_TEST_CYCLES) {
+        test_conn = bt_conn_ref(conn);
+        k_work_reschedule(&test_work, K_MSEC(ADV_RECONNECT_TEST_HOLD_MS));
+    } else if (ADV_RECONNECT_TEST_CYCLES > 0 && stats.count == ADV_RECONNECT_TEST_CYCLES) {
+        LOG_INF("Reconnect test done");
+        log_reconnect_stats();
+    }
+}
+
+static void adv_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    if (hub_is_buzzer_link(conn)) {
+        return;
+    }
+
+    link_lost_ms = k_uptime_get();
+    restart_pending = true;
+
+    if (test_conn) {
+        k_work_cancel_delayable(&test_work);
+        bt_conn_unref(test_conn);
+        test_conn = NULL;
+    }
+}
+
+static void adv_recycled(void)
+{
+    /* The connection slot is free again */
+    k_work_submit(&restart_work);
+}
+
+static void adv_security_changed(struct bt_conn *conn, bt_security_t level,
+                                 enum bt_security_err err)
+{
+    if (hub_is_buzzer_link(conn)) {
+        return;
+    }
+
+    if (err) {
+        LOG_WRN("Security failed (level %u, err %d)", level, err);
+    } else {
+        LOG_INF("Security level %u", level);
+    }
+}
+
+BT_CONN_CB_DEFINE(advertising_conn_callbacks) = {
+    .connected = adv_connected,
+    .disconnected = adv_disconnected,
+    .recycled = adv_recycled,
+    .security_changed = adv_security_changed,
+};
+
+static void pairing_complete(struct bt_conn *conn, bool bond)
+{
+    if (!bond || hub_is_buzzer_link(conn)) {
+        return;
+    }
+
+    /* One bond only: the new central replaces the previous one. With a
+     * single key slot CONFIG_BT_KEYS_OVERWRITE_OLDEST freed it already.
+     */
+    if (bonded && !bt_addr_le_eq(bt_conn_get_dst(conn), &bond_addr)) {
+        bt_unpair(BT_ID_DEFAULT, &bond_addr);
+        LOG_INF("Previous bond replaced");
+    }
+
+    bt_addr_le_copy(&bond_addr, bt_conn_get_dst(conn));
+    bonded = true;
+    build_mfr_data();
+    LOG_INF("Bonded, reconnects start with directed advertising");
+}
+
+static void pairing_failed(struct bt_conn *conn, enum bt_security_err reason)
+{
+    LOG_WRN("Pairing failed (reason %d)", reason);
+}
+
+/* Display-only IO capability for passkey pairing; the passkey is fixed */
+static void auth_passkey_display(struct bt_conn *conn, unsigned int passkey)
+{
+    ARG_UNUSED(conn);
+    ARG_UNUSED(passkey);
+
+    LOG_INF("Passkey pairing, enter CONFIG_BUZZER_IDENTITY_PASSKEY on the host");
+}
+
+static void auth_cancel(struct bt_conn *conn)
+{
+    ARG_UNUSED(conn);
+
+    LOG_WRN("Pairing cancelled");
+}
+
+static struct bt_conn_auth_cb auth_callbacks = {
+    .passkey_display = auth_passkey_display,
+    .cancel = auth_cancel,
+};
+
+static struct bt_conn_auth_info_cb auth_info_callbacks = {
+    .pairing_complete = pairing_complete,
+    .pairing_failed = pairing_failed,
+};
+
+static void bond_found(const struct bt_bond_info *info, void *user_data)
+{
+    ARG_UNUSED(user_data);
+
+    bt_addr_le_copy(&bond_addr, &info->addr);
+    bonded = true;
+}
+
+int advertising_init(void)
+{
+    char addr[BT_ADDR_LE_STR_LEN];
+    int err;
+
+    k_work_init_delayable(&stage_work, stage_work_handler);
+    k_work_init(&restart_work, restart_work_handler);
+    k_work_init_delayable(&test_work, test_work_handler);
+
+    err = bt_passkey_set(CONFIG_BUZZER_IDENTITY_PASSKEY);
+    if (err) {
+        LOG_ERR("Failed to set the passkey (err %d)", err);
+        return err;
+    }
+
+    err = bt_conn_auth_cb_register(&auth_callbacks);
+    if (err) {
+        return err;
+    }
+
+    err = bt_conn_auth_info_cb_register(&auth_info_callbacks);
+    if (err) {
+        return err;
+    }
+
+    bt_foreach_bond(BT_ID_DEFAULT, bond_found, NULL);
+    if (bonded) {
+        bt_addr_le_to_str(&bond_addr, addr, sizeof(addr));
+        LOG_INF("Bonded central: %s", addr);
+    }
+
+    build_mfr_data();
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+/**
+ * Advertising and reconnect module
+ * 
+ * Connectable advertising in stages: a high duty cycle directed burst
+ * toward the bonded central (if any), then undirected advertising that
+ * slows down the longer nobody connects. Restarts by itself when the link
+ * drops, and measures the time from link loss to reconnect.
+ */
+
+#ifndef ADVERTISING_H
+#define ADVERTISING_H
+
+#include <zephyr/types.h>
+#include <zephyr/sys/util.h>
+
+#include "config.h"
+
+/**
+ * Reconnect time statistics (link loss to connected)
+ */
+struct reconnect_stats {
+    uint32_t count;       /* Reconnects measured */
+    uint32_t directed;    /* Of those, through directed advertising */
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint32_t avg_ms;
+    uint32_t buckets[ADV_RECONNECT_BUCKETS];  /* Histogram, see ADV_RECONNECT_BUCKET_LIMITS_MS */
+};
+
+/**
+ * Initialize advertising and look up the bonded central
+ * Call after bt_enable() and settings_load().
+ * 
+ * @return 0 on success, negative errno on failure
+ */
+int advertising_init(void);
+
+/**
+ * Start advertising from the first stage
+ * 
+ * @return 0 on success, negative errno on failure
+ */
+int advertising_start(void);
+
+/* Flags in the advertised manufacturer data */
+#define ADV_MFR_FLAG_READY        BIT(0)  /* Startup finished, buzzer usable */
+#define ADV_MFR_FLAG_BONDED       BIT(1)  /* Bonded to a central (reconnects to it) */
+#define ADV_MFR_FLAG_LOW_BATTERY  BIT(2)  /* Below LED_LOW_BATTERY_THRESHOLD */
+
+/**
+ * Refresh the advertised buzzer ID, battery level and flags
+ * Call when one of them changed; takes effect at once while advertising.
+ */
+void advertising_update_data(void);
+
+/**
+ * Set the ready flag in the advertised data
+ * 
+ * @param is_ready true once the buzzer finished starting up
+ */
+void advertising_set_ready(bool is_ready);
+
+/**
+ * Get the reconnect time statistics since boot
+ * 
+ * @param stats Filled with the statistics
+ */
+void advertising_get_reconnect_stats(struct reconnect_stats *stats);
+
+#endif /* ADVERTISING_H */
@@ -8,6 +8,7 @@
  */
 
 #include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
 #include <zephyr/device.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/adc.h>
@@ -15,6 +16,9 @@
 
 #include "config.h"
 #include "battery.h"
+#include "advertising.h"
+
+LOG_MODULE_REGISTER(battery, BUZZER_LOG_LEVEL);
 
 /* ADC configuration from device tree */
 #define ADC_NODE DT_NODELABEL(adc)
@@ -118,7 +122,7 @@ int battery_init(void)
 {
 #if DT_NODE_EXISTS(ADC_NODE)
     if (!device_is_ready(adc_dev)) {
-        printk("ADC device not ready, battery monitoring disabled\n");
+        LOG_WRN("ADC device not ready, battery monitoring disabled");
         adc_dev = NULL;
         battery_level = 100;
         return 0;  /* Non-critical, continue without ADC */
@@ -126,14 +130,14 @@ int battery_init(void)
 
     int err = adc_channel_setup(adc_dev, &channel_cfg);
     if (err) {
-        printk("ADC channel setup failed (err %d)\n", err);
+        LOG_ERR("ADC channel setup failed (err %d)", err);
         adc_dev = NULL;
         battery_level = 100;
         return 0;  /* Non-critical */
     }
 
     adc_initialized = true;
-    printk("Battery monitoring initialized (18650 Li-ion, AIN7/P0.31)\n");
+    LOG_INF("Battery monitoring initialized (18650 Li-ion, AIN7/P0.31)");
     
     /* Force initial battery reading */
     last_update_time = 0;
@@ -141,7 +145,7 @@ int battery_init(void)
     
     return 0;
 #else
-    printk("ADC not available in device tree, battery monitoring disabled\n");
+    LOG_WRN("ADC not available in device tree, battery monitoring disabled");
     battery_level = 100;
     return 0;
 #endif
@@ -165,7 +169,7 @@ void battery_update(void)
     /* Perform ADC read */
     int err = adc_read(adc_dev, &sequence);
     if (err) {
-        printk("ADC read failed (err %d)\n", err);
+        LOG_ERR("ADC read failed (err %d)", err);
         return;
     }
 
@@ -177,16 +181,17 @@ void battery_update(void)
     if (new_level != battery_level) {
         battery_level = new_level;
         
-        /* Update BLE Battery Service */
+        /* Update BLE Battery Service and the advertised level */
         bt_bas_set_battery_level(battery_level);
+        advertising_update_data();
         
-        printk("Battery: %d%% (%dmV, ADC=%d)\n", battery_level, (int)battery_mv, adc_value);
+        LOG_INF("Battery: %d%% (%dmV, ADC=%d)", battery_level, (int)battery_mv, adc_value);
         
         /* Low battery warning */
         if (battery_mv <= BATTERY_LOW_MV && battery_mv > BATTERY_EMPTY_MV) {
-            printk("WARNING: Low battery! Consider charging.\n");
+            LOG_WRN("Low battery! Consider charging.");
         } else if (battery_mv <= BATTERY_EMPTY_MV) {
-            printk("CRITICAL: Battery empty! Please charge immediately.\n");
+            LOG_ERR("Battery empty! Please charge immediately.");
         }
     }
 }
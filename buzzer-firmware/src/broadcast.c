@@ -0,0 +1,139 @@
+/**
+ * Press broadcast implementation
+ * 
+ * One extended advertising set, non-connectable and non-scannable, started
+ * with a limited number of events per press. The data of a burst is the
+ * press record of the GATT path, prefixed with the buzzer ID, so a receiver
+ * can decode both with the same code.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+
+#include "config.h"
+#include "broadcast.h"
+#include "press_event.h"
+#include "transport.h"
+
+LOG_MODULE_REGISTER(broadcast, BUZZER_LOG_LEVEL);
+
+static struct bt_le_ext_adv *adv_set;
+
+static struct press_broadcast payload;
+
+static const struct bt_data ad[] = {
+    BT_DATA(BT_DATA_MANUFACTURER_DATA, (const uint8_t *)&payload, sizeof(payload)),
+};
+
+static atomic_t burst_active;
+static struct broadcast_stats stats;
+
+/* Advertising set sent callback - the burst is complete */
+static void burst_sent(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_sent_info *info)
+{
+    ARG_UNUSED(adv);
+
+    atomic_clear(&burst_active);
+    stats.bursts_done++;
+    LOG_DBG("Burst done (%u events)", info->num_sent);
+}
+
+static const struct bt_le_ext_adv_cb adv_callbacks = {
+    .sent = burst_sent,
+};
+
+/* Broadcast transport: the newest press replaces the burst still running */
+static size_t broadcast_send(const struct transport_event *events, size_t count)
+{
+    const struct transport_event *event = &events[count - 1];
+    struct press_event_record *record = &payload.record;
+    int err;
+
+    if (atomic_get(&burst_active)) {
+        bt_le_ext_adv_stop(adv_set);
+        stats.superseded++;
+    }
+
+    payload.company_id = sys_cpu_to_le16(ADV_MFR_COMPANY_ID);
+    payload.frame = PRESS_BROADCAST_FRAME;
+    payload.buzzer_id = event->buzzer_id;
+    *record = event->record;
+
+    /* Connection event and anchor mean nothing to a scanner */
+    record->conn_event = 0;
+    record->anchor_offset_us = 0;
+    record->conn_interval = 0;
+    if ((record->flags & PRESS_EVENT_FLAG_TIMESTAMP) && timestamp_is_running()) {
+        record->age_ms = sys_cpu_to_le16(
+            (timestamp_now() - sys_le32_to_cpu(record->edge_us)) / 1000);
+    }
+
+    err = bt_le_ext_adv_set_data(adv_set, ad, ARRAY_SIZE(ad), NULL, 0);
+    if (!err) {
+        err = bt_le_ext_adv_start(adv_set,
+                                  BT_LE_EXT_ADV_START_PARAM(0, BROADCAST_BURST_EVENTS));
+    }
+    if (err) {
+        /* Not worth a retry, the press is stale by the time one would succeed */
+        LOG_ERR("Failed to broadcast press seq %u (err %d)",
+                sys_le16_to_cpu(record->seq), err);
+        stats.errors++;
+        return count;
+    }
+
+    atomic_set(&burst_active, 1);
+    stats.presses++;
+    if (stats.presses % 10 == 0) {
+        LOG_INF("Broadcast: %u presses, %u bursts done, %u superseded, %u errors",
+                stats.presses, stats.bursts_done, stats.superseded, stats.errors);
+    }
+    return count;
+}
+
+static struct transport_event broadcast_queue[TRANSPORT_QUEUE_LEN];
+
+static struct transport broadcast_transport = {
+    .name = "broadcast",
+    .send = broadcast_send,
+    .batch_max = 1,
+    .flags = TRANSPORT_FLAG_PRESSES_ONLY | TRANSPORT_FLAG_CONNECTIONLESS,
+    .queue = broadcast_queue,
+    .queue_len = ARRAY_SIZE(broadcast_queue),
+};
+
+int broadcast_init(void)
+{
+    struct bt_le_adv_param param = {
+        .id = BT_ID_DEFAULT,
+        .sid = BROADCAST_SID,
+        .options = BT_LE_ADV_OPT_EXT_ADV,
+        .interval_min = BROADCAST_INTERVAL_MIN,
+        .interval_max = BROADCAST_INTERVAL_MAX,
+    };
+    int err;
+
+    err = bt_le_ext_adv_create(&param, &adv_callbacks, &adv_set);
+    if (err) {
+        LOG_ERR("Failed to create broadcast set (err %d)", err);
+        return err;
+    }
+
+    err = transport_register(&broadcast_transport);
+    if (err) {
+        return err;
+    }
+
+    /* Edge timestamps without a connection */
+    timestamp_start();
+
+    LOG_INF("Press broadcast ready (%u events per press)", BROADCAST_BURST_EVENTS);
+    return 0;
+}
+
+void broadcast_get_stats(struct broadcast_stats *out)
+{
+    *out = stats;
+}
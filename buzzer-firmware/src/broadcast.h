@@ -0,0 +1,46 @@
+/**
+ * Press broadcast module (CONFIG_BUZZER_BROADCAST)
+ * 
+ * Sends every press as a short burst of non-connectable extended advertising
+ * carrying the buzzer ID, a sequence number and the edge timestamp, so one
+ * scanning host can collect presses from dozens of buzzers without holding
+ * connections. Delivery is best effort: a burst that collides with others
+ * in every one of its BROADCAST_BURST_EVENTS copies is lost.
+ */
+
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <zephyr/types.h>
+
+#include "timestamp.h"
+
+/**
+ * Broadcast statistics since boot
+ */
+struct broadcast_stats {
+    uint32_t presses;       /* Presses broadcast */
+    uint32_t bursts_done;   /* Bursts that sent all their events */
+    uint32_t superseded;    /* Bursts cut short by the next press */
+    uint32_t errors;        /* Presses that could not be broadcast */
+};
+
+/**
+ * Create the broadcast advertising set, register the broadcast transport
+ * and start the press timer
+ * Presses then go out as bursts through transport.h; releases are not
+ * broadcast, and a press during a running burst replaces it.
+ * Call after bt_enable().
+ * 
+ * @return 0 on success, negative errno on failure
+ */
+int broadcast_init(void);
+
+/**
+ * Get the broadcast statistics
+ * 
+ * @param stats Filled with the statistics
+ */
+void broadcast_get_stats(struct broadcast_stats *stats);
+
+#endif /* BROADCAST_H */
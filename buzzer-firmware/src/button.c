@@ -3,11 +3,16 @@
  */
 
 #include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
 #include <zephyr/device.h>
 #include <zephyr/drivers/gpio.h>
 
 #include "config.h"
 #include "button.h"
+#include "timestamp.h"
+#include "event_thread.h"
+
+LOG_MODULE_REGISTER(button, BUZZER_LOG_LEVEL);
 
 #define BUTTON_NODE DT_ALIAS(sw0)
 
@@ -23,10 +28,57 @@ static const struct gpio_dt_spec button = GPIO_DT_SPEC_GET(BUTTON_NODE, gpios);
 static struct gpio_callback button_cb_data;
 static button_callback_t user_callback = NULL;
 
-/* Debounce timer */
+/* Debounce timer (trailing sample in both modes, lockout window in leading-edge mode) */
 static struct k_timer debounce_timer;
 static bool last_button_state = false;
 static bool debounce_in_progress = false;
+static volatile button_debounce_mode_t debounce_mode =
+    BUTTON_DEBOUNCE_LEADING_EDGE ? BUTTON_DEBOUNCE_LEADING : BUTTON_DEBOUNCE_TRAILING;
+
+/* Cycle count and hardware timestamp of the first edge of the current debounce window */
+static uint32_t edge_cycles;
+static struct press_timestamp edge_timestamp;
+
+/* Press benchmark: edges left to inject, the next one a press when even */
+static struct k_timer bench_timer;
+static uint32_t bench_edges;
+
+/* Edge-to-callback latency per debounce mode (written by the event thread) */
+static struct {
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} latency[2];
+
+/* Read the current (not debounced) level of the button pin */
+static bool button_read_state(void)
+{
+#if DT_NODE_EXISTS(BUTTON_NODE)
+    return gpio_pin_get_dt(&button) == 0;  // Active low: 0 = pressed
+#else
+    const struct device *gpio_dev = DEVICE_DT_GET(DT_NODELABEL(gpio0));
+    return gpio_pin_get(gpio_dev, BUTTON_GPIO_PIN) == 0;
+#endif
+}
+
+/* Hand a debounced state change to the event thread (interrupt context) */
+static void report_state(bool pressed)
+{
+    struct button_event ev = {
+        .pressed = pressed,
+        .timestamped = timestamp_is_running(),
+        .debounce_mode = debounce_mode,
+        .edge_cycles = edge_cycles,
+        .ts = edge_timestamp,
+    };
+
+    last_button_state = pressed;
+
+    if (event_thread_post_button(&ev) < 0) {
+        LOG_WRN("Button event dropped, event thread input full");
+    }
+}
 
 /* Debounce timer expiry callback */
 static void debounce_timer_handler(struct k_timer *timer)
@@ -36,25 +88,15 @@ static void debounce_timer_handler(struct k_timer *timer)
     debounce_in_progress = false;
     
     /* Read actual button state after debounce period */
-#if DT_NODE_EXISTS(BUTTON_NODE)
-    int raw_value = gpio_pin_get_dt(&button);
-    bool current_state = (raw_value == 0);  // Active low: 0 = pressed
-    printk("Button debounce: raw=%d, state=%s\n", raw_value, current_state ? "pressed" : "released");
-#else
-    const struct device *gpio_dev = device_get_binding(BUTTON_GPIO_LABEL);
-    int raw_value = gpio_pin_get(gpio_dev, BUTTON_GPIO_PIN);
-    bool current_state = (raw_value == 0);
-    printk("Button debounce: raw=%d, state=%s\n", raw_value, current_state ? "pressed" : "released");
-#endif
+    bool current_state = button_read_state();
     
-    /* Only trigger callback if state actually changed */
+    /* Only trigger callback if state actually changed. In leading-edge mode
+     * the press was already reported, so this confirms the release (or
+     * catches a release that happened inside the lockout window).
+     */
     if (current_state != last_button_state) {
-        last_button_state = current_state;
-        printk("Button state changed to: %s\n", current_state ? "PRESSED" : "RELEASED");
-        
-        if (user_callback) {
-            user_callback(current_state);
-        }
+        report_state(current_state);
+        LOG_DBG("Button state changed to: %s", current_state ? "PRESSED" : "RELEASED");
     }
 }
 
@@ -67,14 +109,122 @@ static void button_pressed_handler(const struct device *dev,
     ARG_UNUSED(cb);
     ARG_UNUSED(pins);
     
-    printk("Button IRQ triggered! pins=0x%08x\n", pins);
-    
-    /* Start debounce timer if not already in progress */
-    if (!debounce_in_progress) {
-        debounce_in_progress = true;
-        k_timer_start(&debounce_timer, K_MSEC(BUTTON_DEBOUNCE_MS), K_NO_WAIT);
-        printk("Debounce timer started\n");
+    /* Ignore bounces while a debounce/lockout window is running */
+    if (debounce_in_progress) {
+        return;
+    }
+
+    edge_cycles = k_cycle_get_32();
+    timestamp_latch_edge(&edge_timestamp);
+    debounce_in_progress = true;
+    k_timer_start(&debounce_timer, K_MSEC(BUTTON_DEBOUNCE_MS), K_NO_WAIT);
+
+    /* Leading-edge: a press edge from the released state is reported now,
+     * the timer then only acts as the lockout window and release sample.
+     */
+    if (debounce_mode == BUTTON_DEBOUNCE_LEADING &&
+        !last_button_state && button_read_state()) {
+        report_state(true);
+    }
+}
+
+/* Benchmark timer expiry callback - one synthetic edge */
+static void bench_timer_handler(struct k_timer *timer)
+{
+    struct button_event ev = {
+        .pressed = (bench_edges % 2 == 0),
+        .timestamped = timestamp_is_running(),
+        .debounce_mode = debounce_mode,
+        .edge_cycles = k_cycle_get_32(),
+    };
+
+    if (ev.timestamped) {
+        ev.ts.edge_us = timestamp_now();
+    }
+
+    if (event_thread_post_button(&ev) < 0) {
+        LOG_WRN("Benchmark event dropped, event thread input full");
+    }
+
+    if (--bench_edges == 0) {
+        k_timer_stop(timer);
+        LOG_INF("Press benchmark: all presses injected");
+    }
+}
+
+void button_bench_start(uint32_t presses, uint32_t rate_hz)
+{
+    k_timeout_t half_period = K_USEC(USEC_PER_SEC / (2 * rate_hz));
+
+    if (!presses || !rate_hz || bench_edges) {
+        return;
     }
+
+    LOG_INF("Press benchmark: %u presses at %u/s", presses, rate_hz);
+    bench_edges = 2 * presses;
+    k_timer_start(&bench_timer, half_period, half_period);
+}
+
+void button_set_debounce_mode(button_debounce_mode_t mode)
+{
+    debounce_mode = mode;
+    LOG_INF("Button debounce mode: %s",
+            mode == BUTTON_DEBOUNCE_LEADING ? "leading-edge" : "trailing-edge");
+}
+
+button_debounce_mode_t button_get_debounce_mode(void)
+{
+    return debounce_mode;
+}
+
+void button_process_event(const struct button_event *ev)
+{
+    if (ev->pressed) {
+        uint8_t mode = ev->debounce_mode;
+        uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - ev->edge_cycles);
+
+        latency[mode].count++;
+        latency[mode].last_us = us;
+        latency[mode].total_us += us;
+        if (us > latency[mode].max_us) {
+            latency[mode].max_us = us;
+        }
+    }
+
+    if (user_callback) {
+        user_callback(ev->pressed, ev->timestamped ? &ev->ts : NULL);
+    }
+}
+
+void button_get_latency_stats(button_debounce_mode_t mode,
+                              struct button_latency_stats *stats)
+{
+    unsigned int key = irq_lock();
+
+    stats->count = latency[mode].count;
+    stats->last_us = latency[mode].last_us;
+    stats->max_us = latency[mode].max_us;
+    stats->avg_us = latency[mode].count ?
+        (uint32_t)(latency[mode].total_us / latency[mode].count) : 0;
+
+    irq_unlock(key);
+}
+
+bool button_is_pressed(void)
+{
+    static bool configured;
+
+    if (!configured) {
+#if DT_NODE_EXISTS(BUTTON_NODE)
+        gpio_pin_configure_dt(&button, GPIO_INPUT);
+#else
+        gpio_pin_configure(DEVICE_DT_GET(DT_NODELABEL(gpio0)), BUTTON_GPIO_PIN,
+                           BUTTON_GPIO_FLAGS);
+#endif
+        configured = true;
+    }
+
+    return button_read_state();
 }
 
 int button_init(button_callback_t callback)
@@ -90,58 +240,64 @@ int button_init(button_callback_t callback)
 #if DT_NODE_EXISTS(BUTTON_NODE)
     /* Use device tree configuration */
     if (!device_is_ready(button.port)) {
-        printk("Button device not ready\n");
+        LOG_ERR("Button device not ready");
         return -ENODEV;
     }
 
     ret = gpio_pin_configure_dt(&button, GPIO_INPUT);
     if (ret < 0) {
-        printk("Failed to configure button pin\n");
+        LOG_ERR("Failed to configure button pin");
         return ret;
     }
 
     ret = gpio_pin_interrupt_configure_dt(&button, GPIO_INT_EDGE_BOTH);
     if (ret < 0) {
-        printk("Failed to configure button interrupt\n");
+        LOG_ERR("Failed to configure button interrupt");
         return ret;
     }
 
     gpio_init_callback(&button_cb_data, button_pressed_handler, BIT(button.pin));
     gpio_add_callback(button.port, &button_cb_data);
+
+    /* Latch edge times in hardware (non-fatal, presses still work without) */
+    timestamp_init(button.pin);
 #else
     /* Manual GPIO configuration - use modern API */
     const struct device *gpio_dev = DEVICE_DT_GET(DT_NODELABEL(gpio0));
     if (!device_is_ready(gpio_dev)) {
-        printk("GPIO device not ready\n");
+        LOG_ERR("GPIO device not ready");
         return -ENODEV;
     }
 
     ret = gpio_pin_configure(gpio_dev, BUTTON_GPIO_PIN, BUTTON_GPIO_FLAGS);
     if (ret < 0) {
-        printk("Failed to configure button pin\n");
+        LOG_ERR("Failed to configure button pin");
         return ret;
     }
 
     ret = gpio_pin_interrupt_configure(gpio_dev, BUTTON_GPIO_PIN, GPIO_INT_EDGE_BOTH);
     if (ret < 0) {
-        printk("Failed to configure button interrupt\n");
+        LOG_ERR("Failed to configure button interrupt");
         return ret;
     }
 
     gpio_init_callback(&button_cb_data, button_pressed_handler, BIT(BUTTON_GPIO_PIN));
     gpio_add_callback(gpio_dev, &button_cb_data);
+
+    timestamp_init(BUTTON_GPIO_PIN);
 #endif
 
     /* Initialize debounce timer */
     k_timer_init(&debounce_timer, debounce_timer_handler, NULL);
+    k_timer_init(&bench_timer, bench_timer_handler, NULL);
 
 #if DT_NODE_EXISTS(BUTTON_NODE)
     /* Read initial button state */
     int initial_state = gpio_pin_get_dt(&button);
-    printk("Button initialized on P0.%d (pin=%d, initial_state=%d)\n", 
-           button.pin, button.pin, initial_state);
+    LOG_INF("Button initialized on P0.%d (pin=%d, initial_state=%d)", 
+            button.pin, button.pin, initial_state);
 #else
-    printk("Button initialized on pin %d (manual config)\n", BUTTON_GPIO_PIN);
+    LOG_INF("Button initialized on pin %d (manual config)", BUTTON_GPIO_PIN);
 #endif
     
     return 0;
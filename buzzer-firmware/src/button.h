@@ -7,12 +7,35 @@
 
 #include <zephyr/types.h>
 
+#include "timestamp.h"
+#include "event_thread.h"
+
 /**
  * Button press callback function type
+ * Runs on the event thread, never in interrupt context.
  * 
  * @param pressed true when button is pressed, false when released
+ * @param ts Hardware timestamp of the edge, NULL if timestamping was not running
+ */
+typedef void (*button_callback_t)(bool pressed, const struct press_timestamp *ts);
+
+/**
+ * Debounce strategy
  */
-typedef void (*button_callback_t)(bool pressed);
+typedef enum {
+    BUTTON_DEBOUNCE_TRAILING = 0,  /* Report the level sampled after the debounce delay */
+    BUTTON_DEBOUNCE_LEADING  = 1,  /* Report the press on the first edge, then lock out */
+} button_debounce_mode_t;
+
+/**
+ * Edge-to-callback latency statistics for one debounce mode
+ */
+struct button_latency_stats {
+    uint32_t count;    /* Number of presses reported */
+    uint32_t last_us;  /* Latency of the most recent press */
+    uint32_t max_us;   /* Worst press latency seen */
+    uint32_t avg_us;   /* Average press latency */
+};
 
 /**
  * Initialize button GPIO and configure interrupt
@@ -22,4 +45,52 @@ typedef void (*button_callback_t)(bool pressed);
  */
 int button_init(button_callback_t callback);
 
+/**
+ * Select the debounce strategy at runtime
+ * 
+ * @param mode BUTTON_DEBOUNCE_LEADING or BUTTON_DEBOUNCE_TRAILING
+ */
+void button_set_debounce_mode(button_debounce_mode_t mode);
+
+/**
+ * Get the active debounce strategy
+ */
+button_debounce_mode_t button_get_debounce_mode(void);
+
+/**
+ * Inject synthetic presses into the input path (press benchmark)
+ * Each press is followed by its release half a period later. The events are
+ * posted from timer context like those of the debounce timer, with the
+ * current time as edge time.
+ * 
+ * @param presses Number of press/release pairs
+ * @param rate_hz Presses per second
+ */
+void button_bench_start(uint32_t presses, uint32_t rate_hz);
+
+/**
+ * Record latency for a posted state change and invoke the button callback
+ * Called by the event thread only.
+ * 
+ * @param ev Event posted by the button interrupt
+ */
+void button_process_event(const struct button_event *ev);
+
+/**
+ * Get edge-to-callback latency statistics for presses reported in a mode
+ * 
+ * @param mode Debounce mode to query
+ * @param stats Filled with the statistics
+ */
+void button_get_latency_stats(button_debounce_mode_t mode,
+                              struct button_latency_stats *stats);
+
+/**
+ * Read the current (not debounced) button level by polling the pin
+ * Usable before button_init(), e.g. to detect a button held at boot.
+ * 
+ * @return true if the button is pressed
+ */
+bool button_is_pressed(void);
+
 #endif /* BUTTON_H */
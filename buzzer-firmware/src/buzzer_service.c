@@ -3,14 +3,28 @@
  */
 
 #include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/bluetooth/uuid.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
 
 #include "config.h"
 #include "buzzer_service.h"
 #include "led.h"
+#include "press_event.h"
+#include "device_info.h"
+#include "battery.h"
+#include "event_queue.h"
+#include "event_thread.h"
+#include "link.h"
+#include "identity.h"
+#include "hub.h"
+#include "transport.h"
+
+LOG_MODULE_REGISTER(buzzer_service, BUZZER_LOG_LEVEL);
 
 /* Service UUID */
 static struct bt_uuid_128 buzzer_service_uuid = BT_UUID_INIT_128(
@@ -26,20 +40,141 @@ static struct bt_uuid_128 led_control_uuid = BT_UUID_INIT_128(
 static struct bt_uuid_128 buzzer_id_uuid = BT_UUID_INIT_128(
     BT_UUID_BUZZER_ID_VAL);
 
+static struct bt_uuid_128 button_event_uuid = BT_UUID_INIT_128(
+    BT_UUID_BUTTON_EVENT_VAL);
+
+static struct bt_uuid_128 led_pattern_uuid = BT_UUID_INIT_128(
+    BT_UUID_LED_PATTERN_VAL);
+
+static struct bt_uuid_128 link_mode_uuid = BT_UUID_INIT_128(
+    BT_UUID_LINK_MODE_VAL);
+
+static struct bt_uuid_128 game_state_uuid = BT_UUID_INIT_128(
+    BT_UUID_GAME_STATE_VAL);
+
+static struct bt_uuid_128 identity_uuid = BT_UUID_INIT_128(
+    BT_UUID_IDENTITY_VAL);
+
+static struct bt_uuid_128 device_info_uuid = BT_UUID_INIT_128(
+    BT_UUID_DEVICE_INFO_VAL);
+
 /* Characteristic values */
 static uint8_t button_state = 0;
 static uint8_t led_rgb[3] = {0, 0, 0};
-static uint8_t buzzer_id = BUZZER_ID;
+
+/* LED patterns stored by the host for LED_PATTERN_OP_TRIGGER */
+static struct {
+    uint8_t led;
+    struct led_pattern pattern;  /* step_count 0 = empty slot */
+} pattern_slots[LED_PATTERN_SLOTS];
+
+/* Game state (game_state_t), written by the host and by the first press.
+ * Presses are gated only once the host wrote a state on this connection.
+ */
+static atomic_t game_state = ATOMIC_INIT(GAME_STATE_IDLE);
+static atomic_t game_state_active;
+static uint32_t changes_suppressed;
+
+/* Round ID of the current question, kept across reconnects so presses
+ * queued while the link was down can be matched against the next round
+ */
+static atomic_t current_round = ATOMIC_INIT(PRESS_EVENT_ROUND_NONE);
+
+/* Round before the last change and the timer value (timestamp_now()) of the
+ * change on link round_changed_link, so a press whose edge precedes the
+ * change keeps its round even when it is processed after it
+ */
+static uint16_t previous_round = PRESS_EVENT_ROUND_NONE;
+static uint32_t round_changed_at_us;
+static uint32_t round_changed_link;
+static bool round_changed_at_valid;
+
+/* Timer value (timestamp_now()) when the armed state was received. Only the
+ * first press after it gets a reaction time.
+ */
+static uint32_t armed_at_us;
+static atomic_t armed_at_valid;
+
+/* Played on the buzzer LED when the host declares this buzzer the winner */
+static const struct led_pattern winner_strobe = {
+    .step_count = 2,
+    .repeat = 20,
+    .steps = {
+        { .level = 255, .duration_ms = 50 },
+        { .level = 0, .duration_ms = 50 },
+    },
+};
+
+/* Connection interval (1.25 ms units) the anchor offsets refer to */
+static uint16_t conn_interval = 0;
 
 /* CCC (Client Characteristic Configuration) for notifications */
 static uint8_t button_state_notify_enabled = 0;
+static uint8_t button_event_notify_enabled = 0;
+
+/* Recently sent event records, indexed by seq, kept for host replay requests */
+static struct press_event_record event_history[BUTTON_EVENT_HISTORY_LEN];
+static uint32_t event_history_link[BUTTON_EVENT_HISTORY_LEN];
+static uint16_t next_event_seq = 0;
+
+/* Lossless delivery of queued events to the current connection (event thread) */
+static struct bt_conn *notify_conn = NULL;
+static atomic_t tx_in_flight;
+static atomic_t tx_confirmed;
+static atomic_t link_generation;
+static atomic_t rewind_pending;
+
+/* Transport that feeds the event queue, defined with its callbacks below */
+static struct transport gatt_transport;
+
+/* Uptime when the current link came up, until the client subscribed (0 = none) */
+static int64_t connected_at_ms;
+
+/* Uptime when the current link came up, until the first button event went out */
+static int64_t first_notify_from_ms;
+
+/* Events numbered, confirmed by the link and dropped as stale since boot */
+static uint32_t events_numbered;
+static uint32_t events_confirmed;
+static uint32_t events_stale;
+
+/* Queue-to-notify latency of the most recent and slowest event */
+static uint32_t notify_latency_last_us;
+static uint32_t notify_latency_max_us;
+
+/* Pending replay range [seq, next_event_seq), as seq | REPLAY_PENDING.
+ * Written by the Replay Request handler (BT RX thread) and advanced by the
+ * event thread with a compare-and-set, so a new request is never lost to
+ * the cursor of the replay in progress.
+ */
+#define REPLAY_PENDING  BIT(16)
+static atomic_t replay_request;
 
 /* Button state CCC changed callback */
 static void button_state_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
 {
     button_state_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
-    printk("Button state notifications %s\n", 
-           button_state_notify_enabled ? "enabled" : "disabled");
+    LOG_INF("Button state notifications %s", 
+            button_state_notify_enabled ? "enabled" : "disabled");
+}
+
+/* Button event CCC changed callback */
+static void button_event_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    button_event_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+    LOG_INF("Button event notifications %s",
+            button_event_notify_enabled ? "enabled" : "disabled");
+
+    /* Time the client needed for discovery and setup after connecting */
+    if (button_event_notify_enabled && connected_at_ms) {
+        LOG_INF("Connect-to-subscribed: %u ms", (uint32_t)(k_uptime_get() - connected_at_ms));
+        connected_at_ms = 0;
+    }
+
+    /* New subscription (e.g. after reconnect): deliver what was queued */
+    if (button_event_notify_enabled) {
+        event_thread_kick();
+    }
 }
 
 /* Button state read callback */
@@ -67,13 +202,15 @@ static ssize_t write_led_control(struct bt_conn *conn,
 
     memcpy(led_rgb, buf, 3);
     
-    /* Update LED */
-    if (led_rgb[0] > 128 || led_rgb[1] > 128 || led_rgb[2] > 128) {
-        led_on();
+    /* Single-colour LED: the brightest component sets the PWM level */
+    uint8_t level = MAX(led_rgb[0], MAX(led_rgb[1], led_rgb[2]));
+
+    if (level) {
+        led_set(LED_BUZZER, level);
     } else {
         led_off();
     }
-    printk("LED updated: %s\n", (led_rgb[0] > 128 || led_rgb[1] > 128 || led_rgb[2] > 128) ? "ON" : "OFF");
+    LOG_DBG("LED updated: level %u", level);
 
     return len;
 }
@@ -92,10 +229,414 @@ static ssize_t read_buzzer_id(struct bt_conn *conn,
                                const struct bt_gatt_attr *attr,
                                void *buf, uint16_t len, uint16_t offset)
 {
+    uint8_t buzzer_id = identity_get()->id;
+
     return bt_gatt_attr_read(conn, attr, buf, len, offset, 
                             &buzzer_id, sizeof(buzzer_id));
 }
 
+/* Identity read callback - ID, colour and device name */
+static ssize_t read_identity(struct bt_conn *conn,
+                              const struct bt_gatt_attr *attr,
+                              void *buf, uint16_t len, uint16_t offset)
+{
+    const struct buzzer_identity *id = identity_get();
+    uint8_t value[4 + IDENTITY_NAME_MAX];
+    size_t name_len = strlen(id->name);
+
+    value[0] = id->id;
+    memcpy(&value[1], id->color, sizeof(id->color));
+    memcpy(&value[4], id->name, name_len);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset,
+                            value, 4 + name_len);
+}
+
+/* Device info read callback - everything a client needs after connecting */
+static ssize_t read_device_info(struct bt_conn *conn,
+                                 const struct bt_gatt_attr *attr,
+                                 void *buf, uint16_t len, uint16_t offset)
+{
+    const struct buzzer_identity *id = identity_get();
+    struct link_status link;
+    struct device_info_record info = {
+        .version = DEVICE_INFO_VERSION,
+        .buzzer_id = id->id,
+        .fw_major = FIRMWARE_VERSION_MAJOR,
+        .fw_minor = FIRMWARE_VERSION_MINOR,
+        .fw_patch = FIRMWARE_VERSION_PATCH,
+        .battery = battery_get_level(),
+        .game_state = atomic_get(&game_state),
+        .led_level = MAX(led_rgb[0], MAX(led_rgb[1], led_rgb[2])),
+        .event_version = PRESS_EVENT_VERSION,
+        .event_size = sizeof(struct press_event_record),
+        .round_id = sys_cpu_to_le16(atomic_get(&current_round)),
+    };
+    uint32_t caps = DEVICE_INFO_CAP_BUTTON_EVENT | DEVICE_INFO_CAP_HW_TIMESTAMP |
+                    DEVICE_INFO_CAP_LED_PATTERN | DEVICE_INFO_CAP_LINK_MODE |
+                    DEVICE_INFO_CAP_PHY_DIAG | DEVICE_INFO_CAP_GAME_STATE |
+                    DEVICE_INFO_CAP_REACTION_TIME | DEVICE_INFO_CAP_ROUND_ID |
+                    DEVICE_INFO_CAP_IDENTITY;
+
+    if (IS_ENABLED(CONFIG_BUZZER_BONDING)) {
+        caps |= DEVICE_INFO_CAP_BONDING;
+    }
+    info.capabilities = sys_cpu_to_le32(caps);
+
+    memcpy(info.color, id->color, sizeof(info.color));
+    link_get_status(&link);
+    info.link_mode = link.mode;
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset,
+                            &info, sizeof(info));
+}
+
+/* Identity write callback - provision this buzzer */
+static ssize_t write_identity(struct bt_conn *conn,
+                               const struct bt_gatt_attr *attr,
+                               const void *buf, uint16_t len,
+                               uint16_t offset, uint8_t flags)
+{
+    const uint8_t *data = buf;
+    char name[IDENTITY_NAME_MAX + 1];
+    size_t name_len;
+
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    if (len < 4 || len > 4 + IDENTITY_NAME_MAX) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    /* Empty name: the default name of the ID */
+    name_len = len - 4;
+    memcpy(name, &data[4], name_len);
+    name[name_len] = '\0';
+
+    if (identity_set(data[0], &data[1], name)) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    LOG_INF("Provisioned over GATT: ID %u, \"%s\"", data[0], identity_get()->name);
+    return len;
+}
+
+/* Drop the timestamps of an event numbered on an earlier link
+ * The edge and connection event timers restart with every connection, so
+ * the host could not map them; it falls back to age_ms for such events.
+ */
+static void strip_stale_timestamps(struct press_event_record *record, uint32_t generation)
+{
+    if (generation == (uint32_t)atomic_get(&link_generation)) {
+        return;
+    }
+
+    record->flags &= ~PRESS_EVENT_FLAG_TIMESTAMP;
+    record->edge_us = 0;
+    record->conn_event = 0;
+    record->anchor_offset_us = 0;
+}
+
+/* Button event read callback - returns the most recent record */
+static ssize_t read_button_event(struct bt_conn *conn,
+                                  const struct bt_gatt_attr *attr,
+                                  void *buf, uint16_t len, uint16_t offset)
+{
+    struct press_event_record record;
+    uint32_t generation;
+    unsigned int key = irq_lock();
+
+    record = event_history[(uint16_t)(next_event_seq - 1) % BUTTON_EVENT_HISTORY_LEN];
+    generation = event_history_link[(uint16_t)(next_event_seq - 1) % BUTTON_EVENT_HISTORY_LEN];
+    irq_unlock(key);
+
+    strip_stale_timestamps(&record, generation);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset,
+                            &record, sizeof(record));
+}
+
+/* Button event write callback - host replay requests */
+static ssize_t write_button_event(struct bt_conn *conn,
+                                   const struct bt_gatt_attr *attr,
+                                   const void *buf, uint16_t len,
+                                   uint16_t offset, uint8_t flags)
+{
+    const uint8_t *data = buf;
+
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    if (len != 3 || data[0] != PRESS_EVENT_OP_REPLAY) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    uint16_t from_seq = sys_get_le16(&data[1]);
+    uint16_t missing = next_event_seq - from_seq;
+
+    /* Only records still in the history can be replayed */
+    if (missing == 0 || missing > BUTTON_EVENT_HISTORY_LEN) {
+        return BT_GATT_ERR(BT_ATT_ERR_OUT_OF_RANGE);
+    }
+
+    LOG_INF("Replay requested from seq %u (%u events)", from_seq, missing);
+    atomic_set(&replay_request, from_seq | REPLAY_PENDING);
+    event_thread_kick();
+
+    return len;
+}
+
+/* Decode <led> <repeat> <steps...> of a PLAY or STORE write */
+static int parse_led_pattern(const uint8_t *data, uint16_t len,
+                             uint8_t *led, struct led_pattern *pattern)
+{
+    uint16_t steps_len;
+
+    if (len < 2 + LED_PATTERN_STEP_SIZE) {
+        return -EINVAL;
+    }
+
+    steps_len = len - 2;
+    if (steps_len % LED_PATTERN_STEP_SIZE ||
+        steps_len / LED_PATTERN_STEP_SIZE > LED_PATTERN_MAX_STEPS ||
+        data[0] >= LED_COUNT) {
+        return -EINVAL;
+    }
+
+    *led = data[0];
+    pattern->repeat = data[1];
+    pattern->step_count = steps_len / LED_PATTERN_STEP_SIZE;
+
+    for (int i = 0; i < pattern->step_count; i++) {
+        const uint8_t *step = &data[2 + i * LED_PATTERN_STEP_SIZE];
+
+        pattern->steps[i].level = step[0];
+        pattern->steps[i].duration_ms = sys_get_le16(&step[1]);
+    }
+
+    return 0;
+}
+
+/* LED pattern write callback - the whole animation runs on the buzzer */
+static ssize_t write_led_pattern(struct bt_conn *conn,
+                                  const struct bt_gatt_attr *attr,
+                                  const void *buf, uint16_t len,
+                                  uint16_t offset, uint8_t flags)
+{
+    const uint8_t *data = buf;
+    struct led_pattern pattern;
+    uint8_t led, slot;
+
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    if (len < 2) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    switch (data[0]) {
+    case LED_PATTERN_OP_STOP:
+        if (len != 2 || data[1] >= LED_COUNT) {
+            return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+        }
+        led_resume(data[1]);
+        break;
+
+    case LED_PATTERN_OP_PLAY:
+        if (parse_led_pattern(&data[1], len - 1, &led, &pattern)) {
+            return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+        }
+        led_play(led, &pattern);
+        LOG_DBG("LED %u pattern: %u steps x%u", led, pattern.step_count, pattern.repeat);
+        break;
+
+    case LED_PATTERN_OP_STORE:
+        slot = data[1];
+        if (slot >= LED_PATTERN_SLOTS ||
+            parse_led_pattern(&data[2], len - 2, &led, &pattern)) {
+            return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+        }
+        pattern_slots[slot].led = led;
+        pattern_slots[slot].pattern = pattern;
+        LOG_DBG("LED pattern stored in slot %u", slot);
+        break;
+
+    case LED_PATTERN_OP_TRIGGER:
+        slot = data[1];
+        if (len != 2 || slot >= LED_PATTERN_SLOTS ||
+            pattern_slots[slot].pattern.step_count == 0) {
+            return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+        }
+        led_play(pattern_slots[slot].led, &pattern_slots[slot].pattern);
+        break;
+
+    default:
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    return len;
+}
+
+/* Link mode read callback - requested mode and current parameters */
+static ssize_t read_link_mode(struct bt_conn *conn,
+                               const struct bt_gatt_attr *attr,
+                               void *buf, uint16_t len, uint16_t offset)
+{
+    struct link_status status;
+
+    link_get_status(&status);
+    status.interval = sys_cpu_to_le16(status.interval);
+    status.latency = sys_cpu_to_le16(status.latency);
+    status.timeout = sys_cpu_to_le16(status.timeout);
+    status.switch_ms = sys_cpu_to_le16(status.switch_ms);
+    status.per_permille = sys_cpu_to_le16(status.per_permille);
+    status.phy_fallbacks = sys_cpu_to_le16(status.phy_fallbacks);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset,
+                            &status, sizeof(status));
+}
+
+/* Link mode write callback - the client arms the buzzer when a question opens */
+static ssize_t write_link_mode(struct bt_conn *conn,
+                                const struct bt_gatt_attr *attr,
+                                const void *buf, uint16_t len,
+                                uint16_t offset, uint8_t flags)
+{
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    if (len != 1) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    if (link_set_mode(((const uint8_t *)buf)[0])) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    return len;
+}
+
+static const char *game_state_name(game_state_t state)
+{
+    static const char *const names[] = {"idle", "armed", "locked", "winner"};
+
+    return state < ARRAY_SIZE(names) ? names[state] : "unknown";
+}
+
+/* Game state read callback */
+static ssize_t read_game_state(struct bt_conn *conn,
+                                const struct bt_gatt_attr *attr,
+                                void *buf, uint16_t len, uint16_t offset)
+{
+    uint8_t state = atomic_get(&game_state);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset,
+                            &state, sizeof(state));
+}
+
+/* Game state write callback - the host opens, closes and decides rounds */
+static ssize_t write_game_state(struct bt_conn *conn,
+                                 const struct bt_gatt_attr *attr,
+                                 const void *buf, uint16_t len,
+                                 uint16_t offset, uint8_t flags)
+{
+    const uint8_t *data = buf;
+    uint8_t state;
+
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    if (len != 1 && len != 3) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    state = data[0];
+    if (state > GAME_STATE_WINNER) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    if (len == 3) {
+        buzzer_service_set_round(sys_get_le16(&data[1]));
+    }
+
+    buzzer_service_set_game_state(state);
+    return len;
+}
+
+void buzzer_service_set_round(uint16_t round_id)
+{
+    unsigned int key = irq_lock();
+    uint16_t old_round = atomic_set(&current_round, round_id);
+
+    if (old_round != round_id) {
+        previous_round = old_round;
+        round_changed_at_valid = timestamp_is_running();
+        round_changed_at_us = round_changed_at_valid ? timestamp_now() : 0;
+        round_changed_link = atomic_get(&link_generation);
+    }
+    irq_unlock(key);
+
+    if (old_round != round_id) {
+        /* Anything still queued belongs to an older round */
+        event_thread_kick();
+    }
+}
+
+void buzzer_service_set_game_state(game_state_t state)
+{
+    /* Taken first, the rest of the handler is not part of the reaction */
+    if (state == GAME_STATE_ARMED && timestamp_is_running()) {
+        armed_at_us = timestamp_now();
+        atomic_set(&armed_at_valid, 1);
+    } else {
+        atomic_clear(&armed_at_valid);
+    }
+
+    atomic_set(&game_state_active, 1);
+    atomic_set(&game_state, state);
+
+    switch (state) {
+    case GAME_STATE_ARMED:
+        /* A new round: dark until pressed, lowest latency link */
+        led_resume(LED_BUZZER);
+        link_set_mode(LINK_MODE_ARMED);
+        break;
+    case GAME_STATE_WINNER:
+        led_play(LED_BUZZER, &winner_strobe);
+        link_set_mode(LINK_MODE_IDLE);
+        break;
+    case GAME_STATE_LOCKED:
+        /* Locked by the host: the round went to the other buzzer */
+        led_resume(LED_BUZZER);
+        link_set_mode(LINK_MODE_IDLE);
+        break;
+    default:
+        led_resume(LED_BUZZER);
+        link_set_mode(LINK_MODE_IDLE);
+        break;
+    }
+
+    LOG_INF("Game state: %s (round %u)", game_state_name(state),
+            (uint16_t)atomic_get(&current_round));
+}
+
+void buzzer_service_reset_game_state(void)
+{
+    /* A new host may not know about game states, report every press again */
+    atomic_clear(&game_state_active);
+    atomic_set(&game_state, GAME_STATE_IDLE);
+    atomic_clear(&armed_at_valid);
+    if (changes_suppressed) {
+        LOG_INF("%u button change(s) suppressed outside armed rounds", changes_suppressed);
+        changes_suppressed = 0;
+    }
+}
+
 /* GATT Service Definition */
 BT_GATT_SERVICE_DEFINE(buzzer_service,
     BT_GATT_PRIMARY_SERVICE(&buzzer_service_uuid),
@@ -118,27 +659,511 @@ BT_GATT_SERVICE_DEFINE(buzzer_service,
                           BT_GATT_CHRC_READ,
                           BT_GATT_PERM_READ,
                           read_buzzer_id, NULL, NULL),
+    
+    /* Button Event Characteristic (versioned press_event_record) */
+    BT_GATT_CHARACTERISTIC(&button_event_uuid.uuid,
+                          BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY |
+                          BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+                          BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+                          read_button_event, write_button_event, NULL),
+    BT_GATT_CCC(button_event_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+    
+    /* LED Pattern Characteristic (on-device animations) */
+    BT_GATT_CHARACTERISTIC(&led_pattern_uuid.uuid,
+                          BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+                          BT_GATT_PERM_WRITE,
+                          NULL, write_led_pattern, NULL),
+    
+    /* Link Mode Characteristic (armed / idle connection parameters) */
+    BT_GATT_CHARACTERISTIC(&link_mode_uuid.uuid,
+                          BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE |
+                          BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+                          BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+                          read_link_mode, write_link_mode, NULL),
+    
+    /* Game State Characteristic (idle / armed / locked / winner) */
+    BT_GATT_CHARACTERISTIC(&game_state_uuid.uuid,
+                          BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE |
+                          BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+                          BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+                          read_game_state, write_game_state, NULL),
+    
+    /* Identity Characteristic (runtime provisioning, passkey pairing only) */
+    BT_GATT_CHARACTERISTIC(&identity_uuid.uuid,
+                          BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+                          BT_GATT_PERM_READ | BT_GATT_PERM_WRITE_AUTHEN,
+                          read_identity, write_identity, NULL),
+    
+    /* Device Info Characteristic (one read after connecting) */
+    BT_GATT_CHARACTERISTIC(&device_info_uuid.uuid,
+                          BT_GATT_CHRC_READ,
+                          BT_GATT_PERM_READ,
+                          read_device_info, NULL, NULL),
 );
 
+/* Attribute offsets inside buzzer_service */
+#define BUTTON_STATE_ATTR  (&buzzer_service.attrs[1])
+#define BUTTON_EVENT_ATTR  (&buzzer_service.attrs[8])
+
+/* Queued event transmitted over the link */
+static void event_sent_cb(struct bt_conn *conn, void *user_data)
+{
+    ARG_UNUSED(conn);
+
+    /* Ignore confirmations from a link that has since dropped */
+    if (POINTER_TO_UINT(user_data) != (uint32_t)atomic_get(&link_generation)) {
+        return;
+    }
+
+    atomic_inc(&tx_confirmed);
+    event_thread_kick();
+}
+
+/* Check whether a queued event belongs to a round the host has left */
+static bool is_stale(const struct press_event_record *record)
+{
+    uint16_t round_id = atomic_get(&current_round);
+
+    return round_id != PRESS_EVENT_ROUND_NONE &&
+           sys_le16_to_cpu(record->round_id) != round_id;
+}
+
+/* Send queued events while TX credits and a subscription exist
+ * Returns true if the stack was out of TX buffers and a retry is needed.
+ */
+static bool drain_queue(struct bt_conn *conn)
+{
+    struct event_queue_entry entry;
+    atomic_val_t confirmed = atomic_clear(&tx_confirmed);
+
+    event_queue_ack(confirmed);
+    atomic_sub(&tx_in_flight, confirmed);
+    events_confirmed += confirmed;
+    if (confirmed) {
+        transport_resume(&gatt_transport);
+    }
+
+    /* Staying below the connection's TX buffer count also keeps
+     * bt_gatt_notify_cb() from blocking this thread on buffer allocation.
+     */
+    while (button_event_notify_enabled &&
+           atomic_get(&tx_in_flight) < EVENT_QUEUE_TX_CREDITS &&
+           event_queue_peek_unsent(&entry)) {
+        if (is_stale(&entry.record)) {
+            /* Skipped without air time and freed at once. The ack frees
+             * the oldest sent slot, which may still be in flight; any event
+             * queued before this one is from the same or an older round, so
+             * nothing current is lost.
+             */
+            event_queue_mark_sent();
+            event_queue_ack(1);
+            events_stale++;
+            transport_resume(&gatt_transport);
+            LOG_INF("Dropped button event seq %u from round %u (stale)",
+                    sys_le16_to_cpu(entry.record.seq),
+                    sys_le16_to_cpu(entry.record.round_id));
+            continue;
+        }
+
+        strip_stale_timestamps(&entry.record, entry.link_generation);
+
+        int64_t age_ms = k_uptime_get() - entry.uptime_ms;
+        struct bt_gatt_notify_params params = {
+            .attr = BUTTON_EVENT_ATTR,
+            .data = &entry.record,
+            .len = MIN(sizeof(entry.record), bt_gatt_get_mtu(conn) - 3),
+            .func = event_sent_cb,
+            .user_data = UINT_TO_POINTER(atomic_get(&link_generation)),
+        };
+
+        entry.record.age_ms = sys_cpu_to_le16(MIN(age_ms, UINT16_MAX));
+
+        /* gatt_send() only queued the event; the notify is its radio cost */
+        timing_t start = timing_counter_get();
+        int err = bt_gatt_notify_cb(conn, &params);
+        timing_t end = timing_counter_get();
+
+        transport_add_send_time(&gatt_transport, &start, &end);
+        if (err == -ENOMEM) {
+            /* No TX buffer, the event stays queued */
+            return true;
+        }
+        if (err) {
+            LOG_ERR("Failed to send button event seq %u (err %d), keeping it queued",
+                    sys_le16_to_cpu(entry.record.seq), err);
+            return false;
+        }
+
+        event_queue_mark_sent();
+        atomic_inc(&tx_in_flight);
+
+        if (first_notify_from_ms) {
+            LOG_INF("Connect-to-first-notification: %u ms",
+                    (uint32_t)(k_uptime_get() - first_notify_from_ms));
+            first_notify_from_ms = 0;
+        }
+
+        notify_latency_last_us = k_cyc_to_us_floor32(k_cycle_get_32() - entry.queued_cycles);
+        if (notify_latency_last_us > notify_latency_max_us) {
+            notify_latency_max_us = notify_latency_last_us;
+        }
+    }
+
+    return false;
+}
+
+static void service_connected(struct bt_conn *conn, uint8_t err)
+{
+    if (err || notify_conn || hub_is_buzzer_link(conn)) {
+        return;
+    }
+
+    notify_conn = bt_conn_ref(conn);
+    connected_at_ms = k_uptime_get();
+    first_notify_from_ms = connected_at_ms;
+
+    /* A bonded client's stored subscription is restored by the host before
+     * this callback runs, so the client needs no CCC write to get events.
+     */
+    if (button_event_notify_enabled) {
+        LOG_INF("Connect-to-subscribed: 0 ms (subscription restored)");
+        connected_at_ms = 0;
+        event_thread_kick();
+    }
+}
+
+static void service_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    if (conn != notify_conn) {
+        return;
+    }
+
+    bt_conn_unref(notify_conn);
+    notify_conn = NULL;
+
+    buzzer_service_reset_game_state();
+
+    /* Confirmations still arriving from this link are ignored from now on.
+     * The queue itself is only touched by its consumer, the event thread.
+     */
+    atomic_inc(&link_generation);
+    atomic_set(&rewind_pending, 1);
+    event_thread_kick();
+}
+
+/* Events in flight may never have reached the host, send them again after
+ * reconnect (the host drops duplicates by sequence number)
+ */
+static void rewind_queue(void)
+{
+    if (!atomic_cas(&rewind_pending, 1, 0)) {
+        return;
+    }
+
+    atomic_clear(&tx_in_flight);
+    atomic_clear(&tx_confirmed);
+    event_queue_rewind();
+
+    if (event_queue_pending()) {
+        LOG_INF("%u button event(s) queued for replay after reconnect",
+                event_queue_pending());
+    }
+}
+
+BT_CONN_CB_DEFINE(buzzer_service_conn_callbacks) = {
+    .connected = service_connected,
+    .disconnected = service_disconnected,
+};
+
+/* Re-send history records until caught up
+ * Returns true if the stack was out of TX buffers and a retry is needed.
+ */
+static bool replay_history(struct bt_conn *conn)
+{
+    while (button_event_notify_enabled) {
+        struct press_event_record record;
+        uint32_t generation;
+        atomic_val_t request;
+        uint16_t seq;
+        unsigned int key = irq_lock();
+
+        /* Local copy of the cursor; a request written while the notify
+         * below yields replaces it, and the compare-and-set that advances
+         * this one fails
+         */
+        request = atomic_get(&replay_request);
+        if (!(request & REPLAY_PENDING)) {
+            irq_unlock(key);
+            break;
+        }
+        seq = (uint16_t)request;
+        if (seq == next_event_seq) {
+            atomic_cas(&replay_request, request, 0);
+            irq_unlock(key);
+            break;
+        }
+        record = event_history[seq % BUTTON_EVENT_HISTORY_LEN];
+        generation = event_history_link[seq % BUTTON_EVENT_HISTORY_LEN];
+        irq_unlock(key);
+
+        if (is_stale(&record)) {
+            atomic_cas(&replay_request, request, (uint16_t)(seq + 1) | REPLAY_PENDING);
+            continue;
+        }
+
+        strip_stale_timestamps(&record, generation);
+        record.flags |= PRESS_EVENT_FLAG_REPLAY;
+
+        int err = bt_gatt_notify(conn, BUTTON_EVENT_ATTR, &record,
+                                 MIN(sizeof(record), bt_gatt_get_mtu(conn) - 3));
+        if (err == -ENOMEM) {
+            /* TX buffers busy, try again later */
+            return true;
+        }
+        if (err) {
+            LOG_ERR("Replay of seq %u failed (err %d)", seq, err);
+            atomic_cas(&replay_request, request, 0);
+            break;
+        }
+        atomic_cas(&replay_request, request, (uint16_t)(seq + 1) | REPLAY_PENDING);
+    }
+
+    return false;
+}
+
+k_timeout_t buzzer_service_process(void)
+{
+    bool retry;
+
+    rewind_queue();
+
+    if (!notify_conn) {
+        return K_FOREVER;
+    }
+
+    /* Hold a reference in case the link drops while a send is in progress */
+    struct bt_conn *conn = bt_conn_ref(notify_conn);
+
+    /* New events first, replays of old ones only after */
+    retry = drain_queue(conn);
+    if (!retry) {
+        retry = replay_history(conn);
+    }
+
+    bt_conn_unref(conn);
+
+    return retry ? K_MSEC(EVENT_QUEUE_RETRY_MS) : K_FOREVER;
+}
+
+/* GATT transport: events are queued until the link confirms them */
+static size_t gatt_send(const struct transport_event *events, size_t count)
+{
+    size_t taken;
+
+    for (taken = 0; taken < count; taken++) {
+        struct event_queue_entry entry = {
+            .record = events[taken].record,
+            .uptime_ms = events[taken].uptime_ms,
+            .queued_cycles = events[taken].queued_cycles,
+            .link_generation = events[taken].link_generation,
+        };
+
+        if (event_queue_put(&entry)) {
+            /* Full: resumed once the link confirms queued events */
+            break;
+        }
+
+        /* Legacy 1-byte Button State characteristic (best effort, not queued) */
+        button_state = (entry.record.type == PRESS_EVENT_TYPE_PRESS) ? 1 : 0;
+
+        if (button_state_notify_enabled) {
+            int err = bt_gatt_notify(NULL, BUTTON_STATE_ATTR,
+                                     &button_state, sizeof(button_state));
+            if (err) {
+                LOG_ERR("Failed to send button notification (err %d)", err);
+            }
+        }
+    }
+
+    if (taken) {
+        event_thread_kick();
+    }
+
+    return taken;
+}
+
+/* Without a connection events wait for the next one, unless a
+ * connectionless transport delivers them already
+ */
+static bool gatt_is_active(void)
+{
+    return notify_conn || !transport_connectionless_active();
+}
+
+/* As long as the event queue: the events are numbered and in the history
+ * already, so events that wait for confirmations are held here, not dropped
+ */
+static struct transport_event gatt_queue[EVENT_QUEUE_LEN];
+
+BUILD_ASSERT(EVENT_QUEUE_LEN <= UINT8_MAX, "GATT transport queue length is 8-bit");
+
+static struct transport gatt_transport = {
+    .name = "gatt",
+    .send = gatt_send,
+    .is_active = gatt_is_active,
+    .batch_max = TRANSPORT_QUEUE_LEN,
+    .queue = gatt_queue,
+    .queue_len = ARRAY_SIZE(gatt_queue),
+};
+
 int buzzer_service_init(void)
 {
-    printk("Buzzer service initialized\n");
+    int err = transport_register(&gatt_transport);
+
+    if (err) {
+        return err;
+    }
+
+    LOG_INF("Buzzer service initialized");
     return 0;
 }
 
-int buzzer_service_send_button_state(bool pressed)
+void buzzer_service_get_notify_latency(uint32_t *last_us, uint32_t *max_us)
 {
-    button_state = pressed ? 1 : 0;
-    
-    if (!button_state_notify_enabled) {
-        return -EACCES;
+    *last_us = notify_latency_last_us;
+    *max_us = notify_latency_max_us;
+}
+
+void buzzer_service_log_event_counts(void)
+{
+    LOG_INF("Button events: %u numbered, %u confirmed by the link, %u stale, "
+            "%u queued, %u refused (queue full)",
+            events_numbered, events_confirmed, events_stale,
+            event_queue_pending(), event_queue_overflows());
+}
+
+void buzzer_service_set_conn_interval(uint16_t interval)
+{
+    conn_interval = interval;
+}
+
+bool buzzer_service_game_state_active(void)
+{
+    return atomic_get(&game_state_active);
+}
+
+bool buzzer_service_gate_button(bool pressed, const struct press_timestamp *ts)
+{
+    if (!atomic_get(&game_state_active)) {
+        return true;
     }
 
-    int err = bt_gatt_notify(NULL, &buzzer_service.attrs[1], 
-                            &button_state, sizeof(button_state));
-    if (err) {
-        printk("Failed to send button notification (err %d)\n", err);
+    /* A press latched before the armed state arrived (still in the input
+     * queue when the host wrote it) does not answer this round
+     */
+    if (pressed && ts && atomic_get(&armed_at_valid) &&
+        (int32_t)(ts->edge_us - armed_at_us) < 0) {
+        LOG_INF("Press %u us before arming ignored", armed_at_us - ts->edge_us);
+        changes_suppressed++;
+        return false;
     }
-    
-    return err;
+
+    /* Only the first press of an armed round goes out; the compare and swap
+     * keeps a host write that arrives at the same time from being lost
+     */
+    if (pressed && atomic_cas(&game_state, GAME_STATE_ARMED, GAME_STATE_LOCKED)) {
+        led_set(LED_BUZZER, UINT8_MAX);
+        LOG_INF("Game state: locked (pressed)");
+        return true;
+    }
+
+    /* Nothing else is sent: no radio activity outside an open question */
+    changes_suppressed++;
+    return false;
+}
+
+/* Round that was current at the edge, the current one without a timestamp */
+static uint16_t round_at_edge(const struct press_timestamp *ts)
+{
+    unsigned int key = irq_lock();
+    uint16_t round_id = atomic_get(&current_round);
+
+    /* Timer values of an earlier link are not comparable; any edge on this
+     * link came after such a change
+     */
+    if (ts && round_changed_at_valid &&
+        round_changed_link == (uint32_t)atomic_get(&link_generation) &&
+        (int32_t)(ts->edge_us - round_changed_at_us) < 0) {
+        round_id = previous_round;
+    }
+    irq_unlock(key);
+
+    return round_id;
+}
+
+void buzzer_service_fill_record(struct press_event_record *record, bool pressed,
+                                const struct press_timestamp *ts)
+{
+    memset(record, 0, sizeof(*record));
+    record->version = PRESS_EVENT_VERSION;
+    record->type = pressed ? PRESS_EVENT_TYPE_PRESS : PRESS_EVENT_TYPE_RELEASE;
+    record->button = PRESS_EVENT_BUTTON_MAIN;
+    record->round_id = sys_cpu_to_le16(round_at_edge(ts));
+
+    if (ts) {
+        record->flags |= PRESS_EVENT_FLAG_TIMESTAMP;
+        record->edge_us = sys_cpu_to_le32(ts->edge_us);
+        record->conn_interval = sys_cpu_to_le16(conn_interval);
+
+        /* Left at 0 (none) when skipped events were not counted */
+        if (link_anchors_valid()) {
+            record->conn_event = sys_cpu_to_le32(ts->conn_event);
+            record->anchor_offset_us = sys_cpu_to_le32(ts->anchor_offset_us);
+        }
+
+        /* Same timer for both ends, so link jitter does not enter the delta.
+         * An edge before the armed write is a pre-arm press: no reaction
+         * time, and the armed time stays for the first press after it.
+         */
+        if (pressed && atomic_get(&armed_at_valid)) {
+            int32_t reaction_us = ts->edge_us - armed_at_us;
+
+            if (reaction_us >= 0 && atomic_cas(&armed_at_valid, 1, 0)) {
+                record->flags |= PRESS_EVENT_FLAG_REACTION;
+                record->reaction_us = sys_cpu_to_le32(reaction_us);
+                LOG_INF("Reaction time: %d us", reaction_us);
+            }
+        }
+    }
+
+    /* Radio conditions at the time of the press, for diagnostics */
+    link_get_radio(&record->phy, &record->rssi);
+}
+
+int buzzer_service_send_button_state(bool pressed, const struct press_timestamp *ts)
+{
+    struct transport_event event = {
+        .buzzer_id = identity_get()->id,
+        .uptime_ms = k_uptime_get(),
+        .queued_cycles = k_cycle_get_32(),
+        .link_generation = atomic_get(&link_generation),
+    };
+    struct press_event_record *record = &event.record;
+
+    buzzer_service_fill_record(record, pressed, ts);
+
+    /* Every event gets one sequence number for all transports and goes
+     * into the replay history. The lock keeps the history consistent for
+     * the read and replay paths.
+     */
+    unsigned int key = irq_lock();
+
+    record->seq = sys_cpu_to_le16(next_event_seq);
+    event_history[next_event_seq % BUTTON_EVENT_HISTORY_LEN] = *record;
+    event_history_link[next_event_seq % BUTTON_EVENT_HISTORY_LEN] = event.link_generation;
+    next_event_seq++;
+    events_numbered++;
+    irq_unlock(key);
+
+    return transport_submit(&event);
 }
@@ -5,8 +5,42 @@
 #ifndef BUZZER_SERVICE_H
 #define BUZZER_SERVICE_H
 
+#include <zephyr/kernel.h>
 #include <zephyr/types.h>
 
+#include "timestamp.h"
+#include "press_event.h"
+
+/* LED Pattern characteristic opcodes (first byte of a write). Steps are
+ * 3 bytes each: level (0-255) and duration in ms (2 bytes, little-endian).
+ * 
+ *   STOP     00 <led>                         back to the idle pattern
+ *   PLAY     01 <led> <repeat> <steps...>     play now (repeat 0 = loop)
+ *   STORE    02 <slot> <led> <repeat> <steps...>
+ *   TRIGGER  03 <slot>                        play a stored pattern
+ */
+#define LED_PATTERN_OP_STOP     0x00
+#define LED_PATTERN_OP_PLAY     0x01
+#define LED_PATTERN_OP_STORE    0x02
+#define LED_PATTERN_OP_TRIGGER  0x03
+#define LED_PATTERN_STEP_SIZE   3
+
+/**
+ * Game state written by the host (Game State characteristic)
+ * Once the host has written a state on a connection, button changes are
+ * only reported while armed, and the first press locks the buzzer out.
+ * 
+ * Write: state (1 byte), optionally followed by a round ID (2 bytes,
+ * little-endian, 0 = none). Events are tagged with the last round ID, and
+ * queued events of an older round are dropped instead of sent.
+ */
+typedef enum {
+    GAME_STATE_IDLE   = 0,  /* No question open, presses are not reported */
+    GAME_STATE_ARMED  = 1,  /* Question open, the first press is reported */
+    GAME_STATE_LOCKED = 2,  /* Pressed already, or the round went to the other buzzer */
+    GAME_STATE_WINNER = 3,  /* This buzzer won the round */
+} game_state_t;
+
 /**
  * Initialize the buzzer GATT service
  * 
@@ -15,11 +49,106 @@
 int buzzer_service_init(void);
 
 /**
- * Send button state notification to connected client
+ * Report a button state change on every transport
+ * Call from the event thread (the button callback). The record is built
+ * and numbered once and handed to the registered transports (transport.h).
+ * On GATT the event is queued and delivered once a client is connected and
+ * subscribed, including events that happened while the link was down.
  * 
  * @param pressed true if button is pressed, false otherwise
- * @return 0 on success, negative errno on failure
+ * @param ts Hardware edge timestamp, or NULL if not available
+ * @return 0 on success, -ENOBUFS if a transport had to drop the event
+ */
+int buzzer_service_send_button_state(bool pressed, const struct press_timestamp *ts);
+
+/**
+ * Apply the game state to a button change
+ * Call from the event thread before buzzer_service_send_button_state(). An
+ * accepted press moves an armed buzzer to locked and holds the buzzer LED on
+ * at once, without waiting for the host.
+ * 
+ * @param pressed true if button is pressed, false otherwise
+ * @param ts Hardware edge timestamp, or NULL if not available. A press whose
+ *           edge precedes the armed state is suppressed.
+ * @return true if the change is to be reported, false if the game state
+ *         suppresses it. Always true until the host writes a game state.
+ */
+bool buzzer_service_gate_button(bool pressed, const struct press_timestamp *ts);
+
+/**
+ * Apply a game state from the host
+ * Used for Game State writes and by operating modes without a connection
+ * (CONFIG_BUZZER_PAWR). Presses are gated from then on, until
+ * buzzer_service_reset_game_state().
+ * 
+ * @param state New game state
+ */
+void buzzer_service_set_game_state(game_state_t state);
+
+/**
+ * Set the round ID that events are tagged with
+ * Queued events of an older round are dropped instead of sent.
+ * 
+ * @param round_id Round ID (PRESS_EVENT_ROUND_NONE = none)
+ */
+void buzzer_service_set_round(uint16_t round_id);
+
+/**
+ * Stop gating presses, back to reporting every change
+ * Called when the host goes away (disconnect, lost periodic sync).
+ */
+void buzzer_service_reset_game_state(void);
+
+/**
+ * Fill a press event record for a button change
+ * Sets everything but the sequence number and the age: round ID,
+ * timestamps, reaction time and radio diagnostics. Call from the event
+ * thread, once per change (the reaction time is only given once per round).
+ * 
+ * @param record Record to fill
+ * @param pressed true if button is pressed, false otherwise
+ * @param ts Hardware edge timestamp, or NULL if not available
+ */
+void buzzer_service_fill_record(struct press_event_record *record, bool pressed,
+                                const struct press_timestamp *ts);
+
+/**
+ * Check whether the host drives the game state on the current connection
+ * 
+ * @return true once a game state was written, until disconnect
+ */
+bool buzzer_service_game_state_active(void);
+
+/**
+ * Submit queued events and pending replays to the stack
+ * Called by the event thread only, whenever it is woken.
+ * 
+ * @return Delay before the next attempt if the stack was out of TX buffers,
+ *         K_FOREVER if nothing is left to send
+ */
+k_timeout_t buzzer_service_process(void);
+
+/**
+ * Set the connection interval reported with timestamped notifications
+ * 
+ * @param interval Connection interval in 1.25 ms units
+ */
+void buzzer_service_set_conn_interval(uint16_t interval);
+
+/**
+ * Get the time from queueing a button event to handing it to the stack
+ * Added to the button edge-to-callback latency this gives edge-to-notify.
+ * 
+ * @param last_us Latency of the most recent event
+ * @param max_us Worst latency seen
+ */
+void buzzer_service_get_notify_latency(uint32_t *last_us, uint32_t *max_us);
+
+/**
+ * Log the button events numbered, confirmed by the link, dropped as stale,
+ * still queued and refused since boot
+ * Without loss, numbered = confirmed + stale + queued and refused = 0.
  */
-int buzzer_service_send_button_state(bool pressed);
+void buzzer_service_log_event_counts(void);
 
 #endif /* BUZZER_SERVICE_H */
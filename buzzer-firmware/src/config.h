@@ -7,25 +7,35 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+/* ==================== FIRMWARE VERSION ==================== */
+/* Reported in the Device Info characteristic; bump on every release */
+#define FIRMWARE_VERSION_MAJOR  1
+#define FIRMWARE_VERSION_MINOR  1
+#define FIRMWARE_VERSION_PATCH  0
+
 /* ==================== BUZZER IDENTIFICATION ==================== */
 /**
- * Set buzzer ID: 1 for Green, 2 for Red
- * IMPORTANT: Flash different IDs to each buzzer
+ * The buzzer ID (1-255), device name and colour are stored in flash and
+ * provisioned at runtime (src/identity.c), so every buzzer runs the same
+ * image. BUZZER_ID_DEFAULT applies until a buzzer has been provisioned.
+ */
+#define BUZZER_ID_DEFAULT 1
+
+/* Default device names: ID 1 and 2 keep the original team names, other IDs
+ * get DEVICE_NAME_PREFIX followed by the ID
  */
-#define BUZZER_ID 1  // Change to 2 for Red buzzer
+#define DEVICE_NAME_GREEN   "Gravitee Quiz Buzzer - Green"
+#define DEVICE_NAME_RED     "Gravitee Quiz Buzzer - Red"
+#define DEVICE_NAME_PREFIX  "Gravitee Quiz Buzzer"
 
-/* Device name will be "Gravitee-Buzzer-Green" or "Gravitee-Buzzer-Red" */
-#define DEVICE_NAME_GREEN "Gravitee Quiz Buzzer - Green"
-#define DEVICE_NAME_RED   "Gravitee Quiz Buzzer - Red"
+/* Longest device name (limited by the Bluetooth device name buffer) */
+#define IDENTITY_NAME_MAX   CONFIG_BT_DEVICE_NAME_MAX
 
-// Ensure the device name matches the buzzer ID
-#if BUZZER_ID == 1
-#define DEVICE_NAME DEVICE_NAME_GREEN
-#elif BUZZER_ID == 2
-#define DEVICE_NAME DEVICE_NAME_RED
-#else
-#error "Invalid BUZZER_ID. Must be 1 (Green) or 2 (Red)."
-#endif
+/* Local provisioning: hold the button this long at boot to enter it, and
+ * again to store the selected ID; it ends without storing after the timeout
+ */
+#define IDENTITY_HOLD_MS                3000
+#define IDENTITY_PROVISION_TIMEOUT_MS   30000
 
 /* ==================== GPIO PIN CONFIGURATION ==================== */
 /* Adjust these based on your actual hardware connections */
@@ -33,6 +43,14 @@
 #define BUTTON_PIN          11  // P0.11 - Button input (active low)
 #define BUTTON_DEBOUNCE_MS  50  // Debounce time in milliseconds
 
+/* Debounce mode (can also be changed at runtime with button_set_debounce_mode)
+ * 1 = leading-edge: report the press on the first edge, then ignore edges for
+ *     BUTTON_DEBOUNCE_MS and confirm the release with the trailing sample
+ * 0 = trailing-edge: wait BUTTON_DEBOUNCE_MS after the first edge and report
+ *     the sampled level (adds a fixed BUTTON_DEBOUNCE_MS delay to every press)
+ */
+#define BUTTON_DEBOUNCE_LEADING_EDGE  1
+
 /* Status LED: Onboard blue LED on P0.15 (active low on Nice!Nano/promicro) */
 #define STATUS_LED_PIN      15  // P0.15 - Onboard blue LED for connection status
 
@@ -40,6 +58,43 @@
 /* Connect: P0.06 (pin 1) -> 220 ohm resistor -> LED anode, LED cathode -> GND */
 #define BUZZER_LED_PIN      6   // P0.06 - External white LED
 
+/* Maximum number of steps in an LED pattern */
+#define LED_PATTERN_MAX_STEPS  8
+
+/* PWM instances driving the LEDs (must match CONFIG_NRFX_PWMx in prj.conf) */
+#define LED_PWM_STATUS_INSTANCE  0
+#define LED_PWM_BUZZER_INSTANCE  1
+
+/* PWM period in us (1 MHz base clock): 1000 = 1 kHz, flicker free */
+#define LED_PWM_TOP  1000
+
+/* Time resolution of LED patterns (ms). Long patterns are played with a
+ * coarser resolution so they fit LED_PWM_SEQ_LEN duty values.
+ */
+#define LED_PWM_STEP_MS  10
+
+/* Duty values per LED pattern buffer (two buffers per LED, 2 bytes each) */
+#define LED_PWM_SEQ_LEN  256
+
+/* Brightness scale at boot, and when the battery is low (percent) */
+#define LED_BRIGHTNESS_DEFAULT_PERCENT      100
+#define LED_BRIGHTNESS_LOW_BATTERY_PERCENT  40
+#define LED_LOW_BATTERY_THRESHOLD           20  /* Battery level (%) */
+
+/* ==================== PRESS TIMESTAMPS ==================== */
+/* TIMER instance used for hardware press timestamps (GPIOTE -> PPI -> CAPTURE)
+ * TIMER0 is reserved by the SoftDevice Controller/MPSL, TIMER1 by the radio
+ * scheduler on some configurations. Must match CONFIG_NRFX_TIMERx in prj.conf.
+ */
+#define TIMESTAMP_TIMER_INSTANCE  2
+
+/* TIMER instance (counter mode) counting connection events, and the EGU the
+ * controller triggers at each connection event start. Must match
+ * CONFIG_NRFX_TIMERx in prj.conf; the EGU must not be used as a SWI by the stack.
+ */
+#define TIMESTAMP_COUNTER_INSTANCE  3
+#define TIMESTAMP_EGU_INSTANCE      3
+
 /* ==================== BLE CONFIGURATION ==================== */
 
 /* Custom Quiz Buzzer Service UUID: 6E400001-B5A3-F393-E0A9-E50E24DCCA9E */
@@ -58,6 +113,70 @@
 #define BT_UUID_BUZZER_ID_VAL \
     BT_UUID_128_ENCODE(0x6e400004, 0xb5a3, 0xf393, 0xe0a9, 0xe50e24dcca9e)
 
+/* Button Event Characteristic UUID: 6E400005-B5A3-F393-E0A9-E50E24DCCA9E */
+#define BT_UUID_BUTTON_EVENT_VAL \
+    BT_UUID_128_ENCODE(0x6e400005, 0xb5a3, 0xf393, 0xe0a9, 0xe50e24dcca9e)
+
+/* LED Pattern Characteristic UUID: 6E400006-B5A3-F393-E0A9-E50E24DCCA9E */
+#define BT_UUID_LED_PATTERN_VAL \
+    BT_UUID_128_ENCODE(0x6e400006, 0xb5a3, 0xf393, 0xe0a9, 0xe50e24dcca9e)
+
+/* LED patterns the host can store on the buzzer and trigger by slot number */
+#define LED_PATTERN_SLOTS  4
+
+/* Link Mode Characteristic UUID: 6E400007-B5A3-F393-E0A9-E50E24DCCA9E */
+#define BT_UUID_LINK_MODE_VAL \
+    BT_UUID_128_ENCODE(0x6e400007, 0xb5a3, 0xf393, 0xe0a9, 0xe50e24dcca9e)
+
+/* Game State Characteristic UUID: 6E400008-B5A3-F393-E0A9-E50E24DCCA9E */
+#define BT_UUID_GAME_STATE_VAL \
+    BT_UUID_128_ENCODE(0x6e400008, 0xb5a3, 0xf393, 0xe0a9, 0xe50e24dcca9e)
+
+/* Identity Characteristic UUID: 6E400009-B5A3-F393-E0A9-E50E24DCCA9E */
+#define BT_UUID_IDENTITY_VAL \
+    BT_UUID_128_ENCODE(0x6e400009, 0xb5a3, 0xf393, 0xe0a9, 0xe50e24dcca9e)
+
+/* Device Info Characteristic UUID: 6E40000A-B5A3-F393-E0A9-E50E24DCCA9E */
+#define BT_UUID_DEVICE_INFO_VAL \
+    BT_UUID_128_ENCODE(0x6e40000a, 0xb5a3, 0xf393, 0xe0a9, 0xe50e24dcca9e)
+
+/* Hub Service UUID (hub variant): 6E400010-B5A3-F393-E0A9-E50E24DCCA9E */
+#define BT_UUID_HUB_SERVICE_VAL \
+    BT_UUID_128_ENCODE(0x6e400010, 0xb5a3, 0xf393, 0xe0a9, 0xe50e24dcca9e)
+
+/* Hub Event Characteristic UUID: 6E400011-B5A3-F393-E0A9-E50E24DCCA9E */
+#define BT_UUID_HUB_EVENT_VAL \
+    BT_UUID_128_ENCODE(0x6e400011, 0xb5a3, 0xf393, 0xe0a9, 0xe50e24dcca9e)
+
+/* Hub Control Characteristic UUID: 6E400012-B5A3-F393-E0A9-E50E24DCCA9E */
+#define BT_UUID_HUB_CONTROL_VAL \
+    BT_UUID_128_ENCODE(0x6e400012, 0xb5a3, 0xf393, 0xe0a9, 0xe50e24dcca9e)
+
+/* Number of sent button event records kept for host replay requests (power of two) */
+#define BUTTON_EVENT_HISTORY_LEN  16
+
+/* Press events buffered while the link is down or TX buffers are busy (power of two) */
+#define EVENT_QUEUE_LEN  32
+
+/* Notifications the event queue may have in flight at once. One TX buffer is
+ * left for the legacy Button State and battery notifications.
+ */
+#define EVENT_QUEUE_TX_CREDITS  (CONFIG_BT_CONN_TX_MAX - 1)
+
+/* Retry delay when the stack has no TX buffer for a queued event */
+#define EVENT_QUEUE_RETRY_MS  10
+
+/* Event transports (src/transport.c): GATT, broadcast, PAwR, wired receiver */
+#define TRANSPORT_MAX  4
+
+/* Events queued in front of a transport while it signals back-pressure, and
+ * the largest batch per send() call. This only needs to cover a burst of
+ * presses; the GATT transport has a queue of EVENT_QUEUE_LEN instead, since
+ * its events are numbered and in the history already and a drop there would
+ * leave a sequence gap on the link.
+ */
+#define TRANSPORT_QUEUE_LEN  4
+
 /* BLE advertising interval (in 0.625ms units)
  * Slower advertising = lower power consumption
  * Fast advertising (20-40ms): ~1-2mA, good for quick discovery
@@ -67,10 +186,191 @@
 #define ADV_INTERVAL_MIN    0x0050  /* 50ms (80 * 0.625ms) */
 #define ADV_INTERVAL_MAX    0x00A0  /* 100ms (160 * 0.625ms) */
 
+/* Advertising stages after boot or link loss (src/advertising.c):
+ * directed - high duty cycle directed advertising toward the bonded central,
+ *            ended by the controller after 1.28 s (skipped without a bond)
+ * fast     - undirected, ADV_FAST_INTERVAL for ADV_FAST_DURATION_MS
+ * normal   - undirected, ADV_INTERVAL for ADV_NORMAL_DURATION_MS
+ * slow     - undirected, ADV_SLOW_INTERVAL until a central connects
+ */
+#define ADV_FAST_INTERVAL_MIN   0x0020  /* 20ms */
+#define ADV_FAST_INTERVAL_MAX   0x0030  /* 30ms */
+#define ADV_FAST_DURATION_MS    10000
+#define ADV_NORMAL_DURATION_MS  60000
+#define ADV_SLOW_INTERVAL_MIN   0x0640  /* 1s */
+#define ADV_SLOW_INTERVAL_MAX   0x0780  /* 1.2s */
+
+/* Manufacturer specific data in the advertising packet, so a host can tell
+ * buzzers apart before connecting: version, buzzer ID, battery level, flags.
+ * 0xFFFF is the Bluetooth SIG company ID reserved for testing.
+ */
+#define ADV_MFR_COMPANY_ID      0xFFFF
+#define ADV_MFR_DATA_VERSION    1
+
+/* Reconnect time histogram (link loss to connected), bucket upper limits */
+#define ADV_RECONNECT_BUCKETS   8
+#define ADV_RECONNECT_BUCKET_LIMITS_MS \
+    { 100, 250, 500, 1000, 2000, 5000, 10000, UINT32_MAX }
+
+/* Reconnect test: disconnect ADV_RECONNECT_TEST_HOLD_MS after every
+ * connection, ADV_RECONNECT_TEST_CYCLES times, then log the histogram.
+ * 0 = off (normal operation)
+ */
+#define ADV_RECONNECT_TEST_CYCLES   0
+#define ADV_RECONNECT_TEST_HOLD_MS  3000
+
+/* Press broadcast (CONFIG_BUZZER_BROADCAST, src/broadcast.c): every press is
+ * sent in BROADCAST_BURST_EVENTS extended advertising events. The controller
+ * adds 0-10 ms of random delay to every event, which spreads the copies of
+ * buzzers pressed at the same moment apart.
+ */
+#define BROADCAST_INTERVAL_MIN  0x0020  /* 20ms (32 * 0.625ms), shortest allowed */
+#define BROADCAST_INTERVAL_MAX  0x0028  /* 25ms (40 * 0.625ms) */
+#define BROADCAST_BURST_EVENTS  8
+#define BROADCAST_SID           1       /* Advertising set ID of the bursts */
+
+/* PAwR classroom mode (CONFIG_BUZZER_PAWR, src/pawr.c): the subevent and
+ * response slot layout comes from the hub. The sync is given up after
+ * PAWR_SYNC_TIMEOUT (10 ms units) without a received event.
+ */
+#define PAWR_SYNC_TIMEOUT       200     /* 2s */
+
+/* ==================== HUB VARIANT ==================== */
+/**
+ * Hub variant (CONFIG_BUZZER_HUB, src/hub.c): connects to up to
+ * HUB_MAX_BUZZERS buzzers (CONFIG_BT_MAX_CONN must be one more, for the game
+ * client), collects press broadcasts and drives a PAwR train, and sends all
+ * presses to the game client as one time-ordered stream.
+ */
+#define HUB_MAX_BUZZERS         8
+
+/* Presses within this window after the first one are ranked by estimated
+ * press time instead of arrival (covers a connection interval of skew)
+ */
+#define HUB_ARBITRATION_WINDOW_MS  20
+
+/* Presses held for ranking at once */
+#define HUB_MERGE_DEPTH         16
+
+/* Time after which a buzzer's last sequence number no longer marks
+ * duplicates, so a buzzer that restarted (sequence back at 0) is heard again
+ */
+#define HUB_SEEN_EXPIRY_MS      10000
+
+/* Arrival later than the best case by more than an event's reported age plus
+ * this is taken as a restarted buzzer timer, not as radio delay
+ */
+#define HUB_RESYNC_SLACK_MS     1000
+
+/* Connection interval toward the buzzers (1.25 ms units), until a buzzer
+ * requests its own armed / idle profile
+ */
+#define HUB_CONN_INTERVAL_MIN   8       /* 10ms */
+#define HUB_CONN_INTERVAL_MAX   12      /* 15ms */
+
+/* PAwR train (with CONFIG_BT_PER_ADV_RSP): HUB_PAWR_SUBEVENTS subevents of
+ * HUB_PAWR_SLOTS response slots each, see the latency table in the README
+ */
+#define HUB_PAWR_SUBEVENTS          2
+#define HUB_PAWR_SLOTS              16
+#define HUB_PAWR_SUBEVENT_INTERVAL  8   /* 10ms (1.25 ms units) */
+#define HUB_PAWR_SLOT_DELAY         1   /* 1.25ms (1.25 ms units) */
+#define HUB_PAWR_SLOT_SPACING       4   /* 0.5ms (0.125 ms units) */
+
+/* ==================== WIRED RECEIVER ==================== */
+/**
+ * Wired receiver (CONFIG_BUZZER_RECEIVER, src/receiver.c): press events go
+ * to the PC over USB CDC-ACM and HID as well, framed as
+ * RECEIVER_SYNC, length, type, payload, CRC-8. On native_sim the CDC-ACM
+ * port is replaced by a pty.
+ */
+#define RECEIVER_SYNC           0xA5
+
+/* Largest frame payload in either direction */
+#define RECEIVER_MAX_PAYLOAD    48
+
+/* Host commands are polled this often (the HID poll interval is
+ * CONFIG_USB_HID_POLL_INTERVAL_MS)
+ */
+#define RECEIVER_POLL_MS        1
+
 /* Connection interval for low latency (in 1.25ms units) */
 #define CONN_INTERVAL_MIN   8   // 10ms
 #define CONN_INTERVAL_MAX   12  // 15ms
 
+/* Link modes requested by the host (Link Mode characteristic), in BLE units:
+ * interval 1.25 ms, supervision timeout 10 ms.
+ * Armed: a question is open, every press must go out at the next event.
+ * Idle: lobby or results screen, the peripheral may skip up to LATENCY events.
+ * Press anchors are off while idle and restart with armed, see src/link.c.
+ */
+#define LINK_ARMED_INTERVAL      6    // 7.5ms
+#define LINK_ARMED_LATENCY       0
+#define LINK_ARMED_TIMEOUT       400  // 4s
+
+#define LINK_IDLE_INTERVAL_MIN   80   // 100ms
+#define LINK_IDLE_INTERVAL_MAX   96   // 120ms
+#define LINK_IDLE_LATENCY        4    // Up to 600ms between radio events
+#define LINK_IDLE_TIMEOUT        600  // 6s
+
+/* Delay before dropping to idle, so the short gap between two questions
+ * does not cost a slow switch back to armed
+ */
+#define LINK_IDLE_DELAY_MS       3000
+
+/* PHY policy: 2M by default, 1M or Coded (S8) when the link is marginal.
+ * Every LINK_QUALITY_PERIOD_MS the controller's per-event QoS reports are
+ * enabled for LINK_QUALITY_WINDOW_MS to measure the packet error rate (CRC
+ * errors and receive timeouts per connection event), and the RSSI is read.
+ */
+#define LINK_QUALITY_PERIOD_MS     5000
+#define LINK_QUALITY_WINDOW_MS     500
+#define LINK_PHY_RSSI_2M_MIN       (-75)  /* dBm, below: fall back from 2M to 1M */
+#define LINK_PHY_RSSI_1M_MIN       (-88)  /* dBm, below: fall back from 1M to Coded */
+#define LINK_PHY_RSSI_HYSTERESIS   6      /* dB above a limit before moving back up */
+#define LINK_PHY_PER_MAX_PERMILLE  100    /* Fall back above 10 % packet errors */
+#define LINK_PHY_PER_OK_PERMILLE   20     /* Move back up only below 2 % */
+#define LINK_PHY_UPGRADE_WINDOWS   2      /* Good windows in a row before moving up */
+
+/* ==================== THREAD PRIORITIES ==================== */
+
+/* Lower number = higher priority. Cooperative threads are never preempted
+ * by other threads, only by interrupts.
+ * 
+ *   Bluetooth host TX / RX   coop 7 / 8  (CONFIG_BT_HCI_TX_PRIO, CONFIG_BT_RX_PRIO)
+ *   Buzzer event thread      coop 9      (EVENT_THREAD_PRIORITY)
+ *   System workqueue         coop 15     (advertising restart, host work)
+ *   main                     preempt 0   (battery reads, statistics)
+ *   Log processing           preempt 14  (CONFIG_LOG_PROCESS_THREAD_PRIORITY)
+ * 
+ * The event thread sits just below the Bluetooth host so the notifications
+ * it submits go out without it getting in the way, and above everything the
+ * application itself runs. main and the log thread are preempted at once;
+ * the system workqueue is only waited for until its current item sleeps or
+ * returns.
+ */
+#define EVENT_THREAD_PRIORITY  9
+
+/* Event thread stack (notification submission runs on it) */
+#define EVENT_THREAD_STACK_SIZE  2048
+
+/* Button events buffered between the interrupt and the event thread (power of two) */
+#define EVENT_THREAD_INPUT_LEN  8
+
+/* Press benchmark: PRESS_BENCH_DELAY_MS after the first connection, inject
+ * PRESS_BENCH_PRESSES press/release pairs at PRESS_BENCH_RATE_HZ presses per
+ * second into the button input path, as if the button was pressed. The
+ * event counts are logged every 10 s. 0 = off (normal operation)
+ */
+#define PRESS_BENCH_PRESSES   0
+#define PRESS_BENCH_RATE_HZ   20
+#define PRESS_BENCH_DELAY_MS  5000
+
+/* ==================== LOGGING ==================== */
+
+/* Log level of the application modules (CONFIG_LOG_DEFAULT_LEVEL applies to the stack) */
+#define BUZZER_LOG_LEVEL  LOG_LEVEL_INF
+
 /* ==================== POWER MANAGEMENT ==================== */
 
 /* LED timeout - automatically turn off LED after this time (ms) */
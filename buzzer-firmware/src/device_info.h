@@ -0,0 +1,57 @@
+/**
+ * Device info record, read by the client right after connecting
+ * 
+ * One read returns everything the client needs before the buzzer is usable
+ * (ID, colour, firmware version, capabilities, battery, modes, LED level and
+ * event format), instead of one read per characteristic. Packed little-endian
+ * wire format with the same rules as the press event record: receivers check
+ * the version byte and ignore trailing bytes they do not understand, so
+ * fields can be appended without bumping the version.
+ */
+
+#ifndef DEVICE_INFO_H
+#define DEVICE_INFO_H
+
+#include <zephyr/types.h>
+#include <zephyr/toolchain.h>
+#include <zephyr/sys/util.h>
+
+/* Record format version */
+#define DEVICE_INFO_VERSION  1
+
+/* Capability bits: features the client may use without looking for them.
+ * A bit is never reused for another feature.
+ */
+#define DEVICE_INFO_CAP_BUTTON_EVENT   BIT(0)   /* Button Event records and replay */
+#define DEVICE_INFO_CAP_HW_TIMESTAMP   BIT(1)   /* Edge and anchor timestamps */
+#define DEVICE_INFO_CAP_LED_PATTERN    BIT(2)   /* LED Pattern characteristic */
+#define DEVICE_INFO_CAP_LINK_MODE      BIT(3)   /* Link Mode characteristic */
+#define DEVICE_INFO_CAP_PHY_DIAG       BIT(4)   /* PHY and RSSI in Link Mode and event records */
+#define DEVICE_INFO_CAP_GAME_STATE     BIT(5)   /* Game State with on-device gating */
+#define DEVICE_INFO_CAP_REACTION_TIME  BIT(6)   /* reaction_us in event records */
+#define DEVICE_INFO_CAP_ROUND_ID       BIT(7)   /* Round IDs in Game State and event records */
+#define DEVICE_INFO_CAP_IDENTITY       BIT(8)   /* Identity characteristic */
+#define DEVICE_INFO_CAP_BONDING        BIT(9)   /* Bonds, stored subscriptions, GATT caching */
+
+/**
+ * Device info record
+ * 20 bytes, fits a default 23-byte ATT MTU read.
+ */
+struct device_info_record {
+    uint8_t  version;           /* DEVICE_INFO_VERSION */
+    uint8_t  buzzer_id;         /* Provisioned ID (1-255) */
+    uint8_t  color[3];          /* Provisioned colour (RGB) */
+    uint8_t  fw_major;          /* Firmware version */
+    uint8_t  fw_minor;
+    uint8_t  fw_patch;
+    uint32_t capabilities;      /* DEVICE_INFO_CAP_* */
+    uint8_t  battery;           /* Battery level (0-100 %) */
+    uint8_t  link_mode;         /* Requested link_mode_t */
+    uint8_t  game_state;        /* game_state_t */
+    uint8_t  led_level;         /* Buzzer LED level set over LED Control (0-255) */
+    uint8_t  event_version;     /* PRESS_EVENT_VERSION */
+    uint8_t  event_size;        /* Full press event record size in bytes */
+    uint16_t round_id;          /* Current round ID (0 = none) */
+} __packed;
+
+#endif /* DEVICE_INFO_H */
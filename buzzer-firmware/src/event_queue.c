@@ -0,0 +1,82 @@
+/**
+ * Lossless press event queue implementation
+ * 
+ * Lock-free: head is only written by the producer, send/tail only by the
+ * consumer. Indices run freely and are reduced modulo EVENT_QUEUE_LEN
+ * (a power of two) on access, so full/empty never need a spare slot.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#include "config.h"
+#include "event_queue.h"
+
+BUILD_ASSERT((EVENT_QUEUE_LEN & (EVENT_QUEUE_LEN - 1)) == 0,
+             "EVENT_QUEUE_LEN must be a power of two");
+
+static struct event_queue_entry entries[EVENT_QUEUE_LEN];
+
+static atomic_t head;     /* Next slot to write (producer) */
+static atomic_t tail;     /* Oldest unconfirmed event (consumer) */
+static atomic_val_t send_idx; /* Next event to send (consumer) */
+static atomic_t overflows;
+
+int event_queue_put(const struct event_queue_entry *entry)
+{
+    atomic_val_t h = atomic_get(&head);
+
+    if ((atomic_val_t)(h - atomic_get(&tail)) >= EVENT_QUEUE_LEN) {
+        atomic_inc(&overflows);
+        return -ENOBUFS;
+    }
+
+    entries[(uint32_t)h % EVENT_QUEUE_LEN] = *entry;
+
+    /* Publish the entry only after it is fully written */
+    atomic_set(&head, h + 1);
+    return 0;
+}
+
+bool event_queue_peek_unsent(struct event_queue_entry *entry)
+{
+    if (send_idx == atomic_get(&head)) {
+        return false;
+    }
+
+    *entry = entries[(uint32_t)send_idx % EVENT_QUEUE_LEN];
+    return true;
+}
+
+void event_queue_mark_sent(void)
+{
+    send_idx++;
+}
+
+void event_queue_ack(uint32_t count)
+{
+    atomic_val_t t = atomic_get(&tail);
+
+    /* Never free beyond what was sent */
+    if ((atomic_val_t)(send_idx - t) < (atomic_val_t)count) {
+        count = send_idx - t;
+    }
+
+    /* Slots become writable for the producer only after this store */
+    atomic_set(&tail, t + count);
+}
+
+void event_queue_rewind(void)
+{
+    send_idx = atomic_get(&tail);
+}
+
+uint32_t event_queue_pending(void)
+{
+    return atomic_get(&head) - atomic_get(&tail);
+}
+
+uint32_t event_queue_overflows(void)
+{
+    return atomic_get(&overflows);
+}
@@ -0,0 +1,76 @@
+/**
+ * Lossless press event queue
+ * 
+ * Bounded single-producer/single-consumer ring of press event records.
+ * The input path produces, the BLE layer consumes. Entries are only freed
+ * once the host link reports them transmitted, so events that were in flight
+ * when the link dropped are sent again after reconnect.
+ * 
+ *   tail            send              head
+ *    |  in flight    |   not yet sent  |
+ *    v               v                 v
+ *   [A][B][C][D][E][F][G][H][ ][ ][ ][ ]
+ */
+
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <zephyr/types.h>
+
+#include "press_event.h"
+
+/**
+ * Queued event: wire record plus the local time it was produced
+ */
+struct event_queue_entry {
+    struct press_event_record record;
+    int64_t uptime_ms;       /* k_uptime_get() when the event was queued */
+    uint32_t queued_cycles;  /* k_cycle_get_32() when the event was queued */
+    uint32_t link_generation; /* Host link the record's timestamps were taken on */
+};
+
+/**
+ * Add an event (producer side)
+ * 
+ * @param entry Event to copy into the queue
+ * @return 0 on success, -ENOBUFS if the queue is full
+ */
+int event_queue_put(const struct event_queue_entry *entry);
+
+/**
+ * Get the next event that has not been sent yet (consumer side)
+ * 
+ * @param entry Filled with the event
+ * @return true if an event was returned
+ */
+bool event_queue_peek_unsent(struct event_queue_entry *entry);
+
+/**
+ * Mark the event returned by event_queue_peek_unsent() as sent (consumer side)
+ */
+void event_queue_mark_sent(void);
+
+/**
+ * Free the oldest sent events once the link confirmed them (consumer side)
+ * 
+ * @param count Number of events confirmed
+ */
+void event_queue_ack(uint32_t count);
+
+/**
+ * Treat all sent-but-unconfirmed events as unsent again (consumer side)
+ * Called when the link drops so they are replayed after reconnect.
+ */
+void event_queue_rewind(void);
+
+/**
+ * Number of events not yet confirmed by the link
+ */
+uint32_t event_queue_pending(void);
+
+/**
+ * Number of events refused because the queue was full
+ */
+uint32_t event_queue_overflows(void);
+
+#endif /* EVENT_QUEUE_H */
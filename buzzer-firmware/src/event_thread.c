@@ -0,0 +1,116 @@
+/**
+ * Buzzer event thread implementation
+ * 
+ * The input ring is single-producer (button interrupt) / single-consumer
+ * (this thread): head is only written by the producer and tail only by the
+ * consumer, so neither side takes a lock. A binary semaphore wakes the thread.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+
+#include "config.h"
+#include "event_thread.h"
+#include "button.h"
+#include "buzzer_service.h"
+
+LOG_MODULE_REGISTER(event_thread, BUZZER_LOG_LEVEL);
+
+BUILD_ASSERT((EVENT_THREAD_INPUT_LEN & (EVENT_THREAD_INPUT_LEN - 1)) == 0,
+             "EVENT_THREAD_INPUT_LEN must be a power of two");
+
+struct input_entry {
+    struct button_event ev;
+    uint32_t posted_cycles;
+};
+
+static struct input_entry input_ring[EVENT_THREAD_INPUT_LEN];
+static atomic_t input_head;  /* Next slot to write (producer) */
+static atomic_t input_tail;  /* Next slot to read (consumer) */
+static atomic_t input_overflows;
+
+static K_SEM_DEFINE(wake_sem, 0, 1);
+
+/* Post-to-handle latency */
+static uint32_t wake_latency_last_us;
+static uint32_t wake_latency_max_us;
+
+int event_thread_post_button(const struct button_event *ev)
+{
+    atomic_val_t h = atomic_get(&input_head);
+
+    if ((atomic_val_t)(h - atomic_get(&input_tail)) >= EVENT_THREAD_INPUT_LEN) {
+        atomic_inc(&input_overflows);
+        return -ENOBUFS;
+    }
+
+    input_ring[(uint32_t)h % EVENT_THREAD_INPUT_LEN].ev = *ev;
+    input_ring[(uint32_t)h % EVENT_THREAD_INPUT_LEN].posted_cycles = k_cycle_get_32();
+
+    /* Publish the entry only after it is fully written */
+    atomic_set(&input_head, h + 1);
+    k_sem_give(&wake_sem);
+    return 0;
+}
+
+void event_thread_kick(void)
+{
+    k_sem_give(&wake_sem);
+}
+
+void event_thread_get_wake_latency(uint32_t *last_us, uint32_t *max_us)
+{
+    *last_us = wake_latency_last_us;
+    *max_us = wake_latency_max_us;
+}
+
+static void handle_input(void)
+{
+    atomic_val_t t = atomic_get(&input_tail);
+
+    while (t != atomic_get(&input_head)) {
+        struct input_entry *entry = &input_ring[(uint32_t)t % EVENT_THREAD_INPUT_LEN];
+
+        wake_latency_last_us = k_cyc_to_us_floor32(k_cycle_get_32() - entry->posted_cycles);
+        if (wake_latency_last_us > wake_latency_max_us) {
+            wake_latency_max_us = wake_latency_last_us;
+        }
+
+        button_process_event(&entry->ev);
+
+        /* Free the slot for the producer */
+        t++;
+        atomic_set(&input_tail, t);
+    }
+}
+
+static void event_thread_main(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+    k_timeout_t retry = K_FOREVER;
+
+    LOG_INF("Event thread started (priority %d)", k_thread_priority_get(k_current_get()));
+
+    while (1) {
+        /* Woken by a button event, a TX completion, a new subscription or
+         * a host request, or after the retry delay when the stack was out
+         * of TX buffers.
+         */
+        k_sem_take(&wake_sem, retry);
+
+        if (atomic_get(&input_overflows)) {
+            LOG_WRN("Button input ring overflowed %d time(s)",
+                    (int)atomic_clear(&input_overflows));
+        }
+
+        handle_input();
+        retry = buzzer_service_process();
+    }
+}
+
+K_THREAD_DEFINE(event_thread_id, EVENT_THREAD_STACK_SIZE,
+                event_thread_main, NULL, NULL, NULL,
+                K_PRIO_COOP(EVENT_THREAD_PRIORITY), 0, 0);
@@ -0,0 +1,52 @@
+/**
+ * Buzzer event thread
+ * 
+ * Dedicated cooperative thread that owns all press handling and notification
+ * submission. The button interrupt posts into a lock-free ring and wakes the
+ * thread; nothing else runs at this priority, so no LED animation, battery
+ * read or advertising restart can sit in front of a press.
+ * See the priority scheme in config.h.
+ */
+
+#ifndef EVENT_THREAD_H
+#define EVENT_THREAD_H
+
+#include <zephyr/types.h>
+
+#include "timestamp.h"
+
+/**
+ * Debounced button state change, as posted by the button interrupt
+ */
+struct button_event {
+    bool pressed;
+    bool timestamped;          /* ts holds valid hardware timestamps */
+    uint8_t debounce_mode;     /* Mode that reported the change (button_debounce_mode_t) */
+    uint32_t edge_cycles;      /* k_cycle_get_32() at the first edge */
+    struct press_timestamp ts;
+};
+
+/**
+ * Post a button event to the thread (interrupt safe, lock-free)
+ * Single producer: only call from the button interrupt and debounce timer,
+ * which run at the same interrupt priority and cannot preempt each other.
+ * 
+ * @param ev Event to copy
+ * @return 0 on success, -ENOBUFS if the ring is full
+ */
+int event_thread_post_button(const struct button_event *ev);
+
+/**
+ * Wake the thread to (re)try notification submission (any context)
+ */
+void event_thread_kick(void);
+
+/**
+ * Get the time from posting an event to the thread starting to handle it
+ * 
+ * @param last_us Latency of the most recent wake-up
+ * @param max_us Worst latency seen
+ */
+void event_thread_get_wake_latency(uint32_t *last_us, uint32_t *max_us);
+
+#endif /* EVENT_THREAD_H */
@@ -0,0 +1,834 @@
+/**
+ * Hub implementation
+ * 
+ * Buzzers reach the hub three ways, all handled in the Bluetooth RX thread:
+ * GATT links (the hub connects to every buzzer advertising the buzzer
+ * service and subscribes to Button Event), press broadcasts picked up while
+ * scanning, and responses in the hub's PAwR train. Every press is stamped
+ * with the hub timer when it arrives, held for HUB_ARBITRATION_WINDOW_MS
+ * after the first one, then ranked by estimated press time and notified in
+ * that order. The press time is the buzzer's edge timestamp mapped onto the
+ * hub timer, as the game client does it (connection event anchors on GATT
+ * links, otherwise the smallest arrival minus edge time seen), or arrival
+ * minus the reported age for records without a timestamp.
+ * 
+ * Game states written to Hub Control are forwarded to every buzzer: as a
+ * Game State write on GATT links and in the PAwR requests.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+
+#include "config.h"
+#include "hub.h"
+#include "buzzer_service.h"
+#include "press_event.h"
+#include "pawr.h"
+#include "timestamp.h"
+#include "receiver.h"
+
+LOG_MODULE_REGISTER(hub, BUZZER_LOG_LEVEL);
+
+/* Hub service UUIDs */
+static struct bt_uuid_128 hub_service_uuid = BT_UUID_INIT_128(
+    BT_UUID_HUB_SERVICE_VAL);
+
+static struct bt_uuid_128 hub_event_uuid = BT_UUID_INIT_128(
+    BT_UUID_HUB_EVENT_VAL);
+
+static struct bt_uuid_128 hub_control_uuid = BT_UUID_INIT_128(
+    BT_UUID_HUB_CONTROL_VAL);
+
+/* Buzzer service UUIDs, looked up on the buzzers */
+static struct bt_uuid_128 buzzer_service_uuid = BT_UUID_INIT_128(
+    BT_UUID_BUZZER_SERVICE_VAL);
+
+static struct bt_uuid_128 button_event_uuid = BT_UUID_INIT_128(
+    BT_UUID_BUTTON_EVENT_VAL);
+
+static struct bt_uuid_128 game_state_uuid = BT_UUID_INIT_128(
+    BT_UUID_GAME_STATE_VAL);
+
+static struct bt_uuid_128 buzzer_id_uuid = BT_UUID_INIT_128(
+    BT_UUID_BUZZER_ID_VAL);
+
+/* Link to one buzzer */
+struct hub_link {
+    struct bt_conn *conn;
+    uint8_t buzzer_id;          /* 0 until read */
+    uint16_t event_handle;
+    uint16_t game_state_handle;
+    uint16_t id_handle;
+    struct bt_gatt_discover_params disc;
+    struct bt_gatt_read_params read;
+    struct bt_gatt_subscribe_params sub;
+    struct bt_gatt_discover_params ccc_disc;
+};
+
+static struct hub_link links[HUB_MAX_BUZZERS];
+static bool connecting;
+
+/* Game state from the game client, forwarded to the buzzers */
+static uint8_t hub_state = GAME_STATE_IDLE;
+static uint16_t hub_round = PRESS_EVENT_ROUND_NONE;
+static uint8_t hub_winner;
+static bool hub_state_set;
+
+/* Presses waiting for the arbitration window to close */
+static struct hub_event pending[HUB_MERGE_DEPTH];
+static uint8_t pending_count;
+static uint8_t next_rank = 1;
+static struct k_work_delayable merge_work;
+
+/* Per source and buzzer ID: last sequence number, to drop duplicates, and
+ * the mapping of the buzzer's timer onto the hub timer
+ */
+struct hub_sender {
+    uint16_t seq;
+    bool seen;
+    bool offset_valid;
+    bool base_valid;
+    uint16_t interval;          /* Connection interval base_us refers to */
+    uint32_t conn_event;        /* Last connection event base_us was fitted on */
+    uint32_t seen_at_us;        /* Hub time of the last new sequence number */
+    uint32_t offset_us;         /* Hub time minus edge time, smallest seen */
+    uint32_t base_us;           /* Hub time of connection event 0 */
+    uint32_t synced_at_us;      /* Hub time of the last offset or base update */
+};
+
+static struct hub_sender senders[HUB_SOURCE_COUNT][UINT8_MAX + 1];
+
+static uint8_t hub_event_notify_enabled;
+
+static void hub_event_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    hub_event_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+    LOG_INF("Hub event notifications %s", hub_event_notify_enabled ? "enabled" : "disabled");
+}
+
+static void forward_game_state(void);
+
+void hub_set_game_state(uint8_t state, uint16_t round_id, uint8_t winner_id)
+{
+    if (state == GAME_STATE_ARMED && (round_id != hub_round || hub_state != GAME_STATE_ARMED)) {
+        /* A new question: ranking starts over */
+        next_rank = 1;
+    }
+
+    hub_state = state;
+    hub_round = round_id;
+    hub_winner = winner_id;
+    hub_state_set = true;
+
+    forward_game_state();
+
+    LOG_INF("Hub game state %u, round %u, winner %u", hub_state, hub_round, hub_winner);
+}
+
+/* Hub Control write callback - state (1), round ID (2), winner ID (1) */
+static ssize_t write_hub_control(struct bt_conn *conn,
+                                  const struct bt_gatt_attr *attr,
+                                  const void *buf, uint16_t len,
+                                  uint16_t offset, uint8_t flags)
+{
+    const uint8_t *data = buf;
+
+    if (offset != 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    if (len != 4) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    if (data[0] > GAME_STATE_WINNER) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    hub_set_game_state(data[0], sys_get_le16(&data[1]), data[3]);
+    return len;
+}
+
+BT_GATT_SERVICE_DEFINE(hub_service,
+    BT_GATT_PRIMARY_SERVICE(&hub_service_uuid),
+
+    /* Hub Event Characteristic (struct hub_event, time-ordered) */
+    BT_GATT_CHARACTERISTIC(&hub_event_uuid.uuid,
+                          BT_GATT_CHRC_NOTIFY,
+                          BT_GATT_PERM_NONE,
+                          NULL, NULL, NULL),
+    BT_GATT_CCC(hub_event_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+
+    /* Hub Control Characteristic (game state for all buzzers) */
+    BT_GATT_CHARACTERISTIC(&hub_control_uuid.uuid,
+                          BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+                          BT_GATT_PERM_WRITE,
+                          NULL, write_hub_control, NULL),
+);
+
+#define HUB_EVENT_ATTR  (&hub_service.attrs[1])
+
+/* ==================== Merge and arbitration ==================== */
+
+/* Track the smallest hub-minus-buzzer time seen, allowed to rise by 100 ppm
+ * of the time since the last update (crystal drift). A sample later than
+ * the estimate by more than the event's own age plus HUB_RESYNC_SLACK_MS
+ * means the buzzer's timer restarted; the estimate starts over from it.
+ */
+static void track_min(uint32_t *estimate, bool *valid, uint32_t sample,
+                      uint32_t elapsed_us, uint32_t age_us)
+{
+    if (*valid && (int32_t)(sample - *estimate) > (int32_t)(age_us + HUB_RESYNC_SLACK_MS * 1000U)) {
+        *valid = false;
+    }
+
+    if (!*valid) {
+        *estimate = sample;
+        *valid = true;
+        return;
+    }
+
+    *estimate += elapsed_us / 10000U;
+    if ((int32_t)(sample - *estimate) < 0) {
+        *estimate = sample;
+    }
+}
+
+/* Estimated press time on the hub timer
+ * Connection events are only used on GATT links (hub_link), anywhere else
+ * they would be those of a link to another central.
+ */
+static uint32_t press_time(struct hub_sender *sender, const struct press_event_record *record,
+                           uint16_t len, uint32_t capture_us, bool hub_link)
+{
+    uint32_t elapsed_us = capture_us - sender->synced_at_us;
+    uint32_t age_us = 0;
+    uint32_t edge_us = sys_le32_to_cpu(record->edge_us);
+    uint32_t conn_event = sys_le32_to_cpu(record->conn_event);
+    uint16_t interval = sys_le16_to_cpu(record->conn_interval);
+
+    if (len >= offsetof(struct press_event_record, phy)) {
+        age_us = sys_le16_to_cpu(record->age_ms) * 1000U;
+    }
+
+    if (!(record->flags & PRESS_EVENT_FLAG_TIMESTAMP)) {
+        return capture_us - age_us;
+    }
+
+    sender->synced_at_us = capture_us;
+
+    /* Anchors are scheduled by this hub's controller: event N starts at
+     * base + N * interval, and a notification queued in event N arrives in
+     * N + 1 at the earliest. Immune to the buzzer's crystal drift.
+     */
+    if (hub_link && conn_event && interval) {
+        uint32_t interval_us = interval * 1250U;
+
+        /* New spacing, or the buzzer restarted its count after latency */
+        if (sender->interval != interval || conn_event < sender->conn_event) {
+            sender->interval = interval;
+            sender->base_valid = false;
+        }
+        sender->conn_event = conn_event;
+        track_min(&sender->base_us, &sender->base_valid,
+                  capture_us - (conn_event + 1) * interval_us, elapsed_us, age_us);
+        return sender->base_us + conn_event * interval_us +
+               sys_le32_to_cpu(record->anchor_offset_us);
+    }
+
+    /* Free-running buzzer timer: link delays only add to arrival minus edge */
+    track_min(&sender->offset_us, &sender->offset_valid, capture_us - edge_us,
+              elapsed_us, age_us);
+    return edge_us + sender->offset_us;
+}
+
+/* Take a press from any source; RX thread */
+static void ingest(uint8_t source, uint8_t buzzer_id, const void *data, uint16_t len)
+{
+    struct hub_event event = {
+        .version = HUB_EVENT_VERSION,
+        .buzzer_id = buzzer_id,
+        .source = source,
+        .capture_us = timestamp_now(),
+    };
+    struct press_event_record *record = &event.record;
+    struct hub_sender *sender = &senders[source][buzzer_id];
+    uint16_t seq;
+    uint16_t round_id;
+
+    memcpy(record, data, MIN(len, sizeof(*record)));
+    if (len < offsetof(struct press_event_record, age_ms) ||
+        record->version != PRESS_EVENT_VERSION || record->type != PRESS_EVENT_TYPE_PRESS) {
+        return;
+    }
+
+    /* Replays, broadcast copies and repeated PAwR responses. After
+     * HUB_SEEN_EXPIRY_MS an old sequence number means the buzzer restarted,
+     * and with it its timer.
+     */
+    seq = sys_le16_to_cpu(record->seq);
+    if (sender->seen && (int16_t)(seq - sender->seq) <= 0) {
+        if (event.capture_us - sender->seen_at_us < HUB_SEEN_EXPIRY_MS * 1000U) {
+            return;
+        }
+        LOG_INF("Buzzer %u restarted its sequence numbers (source %u)", buzzer_id, source);
+        memset(sender, 0, sizeof(*sender));
+    }
+    sender->seq = seq;
+    sender->seen = true;
+    sender->seen_at_us = event.capture_us;
+
+    /* A press of an older question (broadcasts carry no round) */
+    round_id = sys_le16_to_cpu(record->round_id);
+    if (round_id != PRESS_EVENT_ROUND_NONE && round_id != hub_round) {
+        LOG_INF("Dropped press of buzzer %u from round %u (stale)", buzzer_id, round_id);
+        return;
+    }
+
+    event.press_us = press_time(sender, record, len, event.capture_us,
+                                source == HUB_SOURCE_GATT);
+
+    unsigned int key = irq_lock();
+
+    if (pending_count == HUB_MERGE_DEPTH) {
+        irq_unlock(key);
+        LOG_WRN("Merge buffer full, press of buzzer %u dropped", buzzer_id);
+        return;
+    }
+    pending[pending_count++] = event;
+    if (pending_count == 1) {
+        k_work_schedule(&merge_work, K_MSEC(HUB_ARBITRATION_WINDOW_MS));
+    }
+    irq_unlock(key);
+}
+
+/* Merge work handler - rank the window's presses and send them in order */
+static void merge_work_handler(struct k_work *work)
+{
+    struct hub_event events[HUB_MERGE_DEPTH];
+    uint8_t count;
+
+    ARG_UNUSED(work);
+
+    unsigned int key = irq_lock();
+
+    count = pending_count;
+    memcpy(events, pending, count * sizeof(events[0]));
+    pending_count = 0;
+    irq_unlock(key);
+
+    /* Insertion sort by press time (wrap-safe), a handful of entries */
+    for (int i = 1; i < count; i++) {
+        struct hub_event e = events[i];
+        int j = i - 1;
+
+        while (j >= 0 && (int32_t)(events[j].press_us - e.press_us) > 0) {
+            events[j + 1] = events[j];
+            j--;
+        }
+        events[j + 1] = e;
+    }
+
+    for (int i = 0; i < count; i++) {
+        events[i].capture_us = sys_cpu_to_le32(events[i].capture_us);
+        events[i].press_us = sys_cpu_to_le32(events[i].press_us);
+        events[i].rank = next_rank < UINT8_MAX ? next_rank++ : UINT8_MAX;
+
+        if (events[i].rank == 1) {
+            LOG_INF("First press: buzzer %u (round %u)", events[i].buzzer_id, hub_round);
+        }
+
+        if (hub_event_notify_enabled) {
+            int err = bt_gatt_notify(NULL, HUB_EVENT_ATTR, &events[i], sizeof(events[i]));
+
+            if (err) {
+                LOG_ERR("Failed to send hub event (err %d)", err);
+            }
+        }
+
+        if (IS_ENABLED(CONFIG_BUZZER_RECEIVER)) {
+            receiver_send(RECEIVER_FRAME_HUB_EVENT, &events[i], sizeof(events[i]));
+        }
+    }
+}
+
+/* ==================== GATT links to buzzers ==================== */
+
+static struct hub_link *link_of(struct bt_conn *conn)
+{
+    for (int i = 0; i < ARRAY_SIZE(links); i++) {
+        if (links[i].conn == conn) {
+            return &links[i];
+        }
+    }
+
+    return NULL;
+}
+
+static struct hub_link *free_link(void)
+{
+    return link_of(NULL);
+}
+
+/* Game state for one buzzer: the winner of a round gets WINNER, the others LOCKED */
+static uint8_t state_for(uint8_t buzzer_id)
+{
+    if (hub_state == GAME_STATE_WINNER && buzzer_id != hub_winner) {
+        return GAME_STATE_LOCKED;
+    }
+
+    return hub_state;
+}
+
+static void write_link_state(struct hub_link *link)
+{
+    uint8_t value[3];
+    int err;
+
+    if (!link->conn || !link->game_state_handle || !link->buzzer_id || !hub_state_set) {
+        return;
+    }
+
+    value[0] = state_for(link->buzzer_id);
+    sys_put_le16(hub_round, &value[1]);
+
+    err = bt_gatt_write_without_response(link->conn, link->game_state_handle,
+                                         value, sizeof(value), false);
+    if (err) {
+        LOG_WRN("Failed to forward game state to buzzer %u (err %d)", link->buzzer_id, err);
+    }
+}
+
+static void forward_game_state(void)
+{
+    for (int i = 0; i < ARRAY_SIZE(links); i++) {
+        write_link_state(&links[i]);
+    }
+}
+
+static uint8_t button_event_notify(struct bt_conn *conn,
+                                   struct bt_gatt_subscribe_params *params,
+                                   const void *data, uint16_t length)
+{
+    struct hub_link *link = CONTAINER_OF(params, struct hub_link, sub);
+
+    if (!data) {
+        params->value_handle = 0;
+        return BT_GATT_ITER_STOP;
+    }
+
+    ingest(HUB_SOURCE_GATT, link->buzzer_id, data, length);
+    return BT_GATT_ITER_CONTINUE;
+}
+
+static void subscribe(struct hub_link *link)
+{
+    int err;
+
+    link->sub.notify = button_event_notify;
+    link->sub.value = BT_GATT_CCC_NOTIFY;
+    link->sub.value_handle = link->event_handle;
+    link->sub.ccc_handle = 0;   /* Looked up by the host (AUTO_DISCOVER_CCC) */
+    link->sub.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+    link->sub.disc_params = &link->ccc_disc;
+
+    err = bt_gatt_subscribe(link->conn, &link->sub);
+    if (err && err != -EALREADY) {
+        LOG_ERR("Failed to subscribe to buzzer %u (err %d)", link->buzzer_id, err);
+        return;
+    }
+
+    LOG_INF("Buzzer %u connected", link->buzzer_id);
+    write_link_state(link);
+}
+
+static uint8_t id_read(struct bt_conn *conn, uint8_t err,
+                       struct bt_gatt_read_params *params,
+                       const void *data, uint16_t length)
+{
+    struct hub_link *link = CONTAINER_OF(params, struct hub_link, read);
+
+    if (err || !data || length < 1) {
+        LOG_ERR("Failed to read buzzer ID (err %u)", err);
+        bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+        return BT_GATT_ITER_STOP;
+    }
+
+    link->buzzer_id = ((const uint8_t *)data)[0];
+
+    /* A new link: sequence numbers may restart and the buzzer's timers
+     * restart with the connection
+     */
+    memset(&senders[HUB_SOURCE_GATT][link->buzzer_id], 0, sizeof(senders[0][0]));
+
+    subscribe(link);
+    return BT_GATT_ITER_STOP;
+}
+
+static uint8_t discover_chrc(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                             struct bt_gatt_discover_params *params)
+{
+    struct hub_link *link = CONTAINER_OF(params, struct hub_link, disc);
+    const struct bt_gatt_chrc *chrc;
+    int err;
+
+    if (attr) {
+        chrc = attr->user_data;
+        if (!bt_uuid_cmp(chrc->uuid, &button_event_uuid.uuid)) {
+            link->event_handle = chrc->value_handle;
+        } else if (!bt_uuid_cmp(chrc->uuid, &game_state_uuid.uuid)) {
+            link->game_state_handle = chrc->value_handle;
+        } else if (!bt_uuid_cmp(chrc->uuid, &buzzer_id_uuid.uuid)) {
+            link->id_handle = chrc->value_handle;
+        }
+        return BT_GATT_ITER_CONTINUE;
+    }
+
+    /* Discovery complete */
+    if (!link->event_handle || !link->id_handle) {
+        LOG_WRN("Buzzer without Button Event, disconnecting");
+        bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+        return BT_GATT_ITER_STOP;
+    }
+
+    link->read.func = id_read;
+    link->read.handle_count = 1;
+    link->read.single.handle = link->id_handle;
+    link->read.single.offset = 0;
+
+    err = bt_gatt_read(conn, &link->read);
+    if (err) {
+        LOG_ERR("Failed to read buzzer ID (err %d)", err);
+        bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+    }
+
+    return BT_GATT_ITER_STOP;
+}
+
+static void discover(struct hub_link *link)
+{
+    int err;
+
+    link->disc.uuid = NULL;
+    link->disc.func = discover_chrc;
+    link->disc.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+    link->disc.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+    link->disc.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+    err = bt_gatt_discover(link->conn, &link->disc);
+    if (err) {
+        LOG_ERR("Discovery failed to start (err %d)", err);
+        bt_conn_disconnect(link->conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+    }
+}
+
+/* ==================== Scanning ==================== */
+
+static void start_scan(void);
+
+struct adv_info {
+    bool buzzer_service;
+    bool press_broadcast;
+    const uint8_t *mfr;
+    uint8_t mfr_len;
+};
+
+static bool parse_adv(struct bt_data *data, void *user_data)
+{
+    struct adv_info *adv = user_data;
+
+    switch (data->type) {
+    case BT_DATA_UUID128_ALL:
+    case BT_DATA_UUID128_SOME:
+        for (int i = 0; i + 16 <= data->data_len; i += 16) {
+            if (!memcmp(&data->data[i], buzzer_service_uuid.val, 16)) {
+                adv->buzzer_service = true;
+            }
+        }
+        break;
+    case BT_DATA_MANUFACTURER_DATA:
+        if (data->data_len >= 4 && sys_get_le16(data->data) == ADV_MFR_COMPANY_ID &&
+            data->data[2] == PRESS_BROADCAST_FRAME) {
+            adv->press_broadcast = true;
+            adv->mfr = data->data;
+            adv->mfr_len = data->data_len;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return true;
+}
+
+static void scan_recv(const struct bt_le_scan_recv_info *info, struct net_buf_simple *buf)
+{
+    struct adv_info adv = { 0 };
+    struct hub_link *link;
+    int err;
+
+    bt_data_parse(buf, parse_adv, &adv);
+
+    /* Press broadcast: company ID (2), frame, buzzer ID, record */
+    if (adv.press_broadcast) {
+        ingest(HUB_SOURCE_BROADCAST, adv.mfr[3], &adv.mfr[4], adv.mfr_len - 4);
+        return;
+    }
+
+    if (!adv.buzzer_service || connecting ||
+        !(info->adv_props & BT_GAP_ADV_PROP_CONNECTABLE)) {
+        return;
+    }
+
+    link = free_link();
+    if (!link) {
+        return;
+    }
+
+    /* The controller cannot scan and initiate at the same time */
+    bt_le_scan_stop();
+    err = bt_conn_le_create(info->addr, BT_CONN_LE_CREATE_CONN,
+                            BT_LE_CONN_PARAM(HUB_CONN_INTERVAL_MIN, HUB_CONN_INTERVAL_MAX,
+                                             0, 400),
+                            &link->conn);
+    if (err) {
+        LOG_WRN("Failed to connect to buzzer (err %d)", err);
+        link->conn = NULL;
+        start_scan();
+        return;
+    }
+
+    connecting = true;
+}
+
+static struct bt_le_scan_cb scan_callbacks = {
+    .recv = scan_recv,
+};
+
+static void start_scan(void)
+{
+    /* Extended scanning, so broadcasts on the secondary channels are seen too */
+    int err = bt_le_scan_start(BT_LE_SCAN_PASSIVE_CONTINUOUS, NULL);
+
+    if (err && err != -EALREADY) {
+        LOG_ERR("Scanning failed to start (err %d)", err);
+    }
+}
+
+static void hub_connected(struct bt_conn *conn, uint8_t err)
+{
+    struct hub_link *link = link_of(conn);
+
+    if (!hub_is_buzzer_link(conn) || !link) {
+        return;
+    }
+
+    connecting = false;
+
+    if (err) {
+        LOG_WRN("Connection to buzzer failed (err %u)", err);
+        bt_conn_unref(link->conn);
+        link->conn = NULL;
+    } else {
+        link->buzzer_id = 0;
+        link->event_handle = 0;
+        link->game_state_handle = 0;
+        link->id_handle = 0;
+        discover(link);
+    }
+
+    start_scan();
+}
+
+static void hub_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    struct hub_link *link = link_of(conn);
+
+    if (!hub_is_buzzer_link(conn) || !link) {
+        return;
+    }
+
+    LOG_INF("Buzzer %u disconnected (reason %u)", link->buzzer_id, reason);
+    bt_conn_unref(link->conn);
+    link->conn = NULL;
+
+    /* A slot is free again */
+    start_scan();
+}
+
+BT_CONN_CB_DEFINE(hub_conn_callbacks) = {
+    .connected = hub_connected,
+    .disconnected = hub_disconnected,
+};
+
+/* ==================== PAwR train ==================== */
+
+#if defined(CONFIG_BT_PER_ADV_RSP)
+static struct bt_le_ext_adv *pawr_adv;
+
+/* Slots heard from per subevent since its last request */
+static uint32_t pawr_acks[HUB_PAWR_SUBEVENTS];
+
+static struct bt_le_per_adv_subevent_data_params subevent_params[HUB_PAWR_SUBEVENTS];
+static struct net_buf_simple subevent_bufs[HUB_PAWR_SUBEVENTS];
+static uint8_t subevent_data[HUB_PAWR_SUBEVENTS][2 + sizeof(struct pawr_request)];
+
+static const uint8_t beacon_data[] = {
+    BT_BYTES_LIST_LE16(ADV_MFR_COMPANY_ID), PAWR_BEACON_FRAME,
+};
+
+static const struct bt_data beacon_ad[] = {
+    BT_DATA(BT_DATA_MANUFACTURER_DATA, beacon_data, sizeof(beacon_data)),
+};
+
+/* The controller asks for request data ahead of the subevents */
+static void pawr_request(struct bt_le_ext_adv *adv, const struct bt_le_per_adv_data_request *request)
+{
+    uint8_t count = MIN(request->count, HUB_PAWR_SUBEVENTS);
+    int err;
+
+    for (int i = 0; i < count; i++) {
+        uint8_t subevent = (request->start + i) % HUB_PAWR_SUBEVENTS;
+        struct pawr_request req = {
+            .company_id = sys_cpu_to_le16(ADV_MFR_COMPANY_ID),
+            .frame = PAWR_REQUEST_FRAME,
+            .round_id = sys_cpu_to_le16(hub_round),
+            .cue = PAWR_CUE_NONE,
+            .ack_slots = sys_cpu_to_le32(pawr_acks[subevent]),
+        };
+
+        switch (hub_state) {
+        case GAME_STATE_ARMED:
+            req.phase = PAWR_PHASE_ARMED;
+            break;
+        case GAME_STATE_LOCKED:
+        case GAME_STATE_WINNER:
+            req.phase = PAWR_PHASE_CLOSED;
+            req.winner_id = hub_state == GAME_STATE_WINNER ? hub_winner : 0;
+            break;
+        default:
+            req.phase = PAWR_PHASE_IDLE;
+            break;
+        }
+        pawr_acks[subevent] = 0;
+
+        net_buf_simple_init_with_data(&subevent_bufs[i], subevent_data[i],
+                                      sizeof(subevent_data[i]));
+        net_buf_simple_reset(&subevent_bufs[i]);
+        net_buf_simple_add_u8(&subevent_bufs[i], 1 + sizeof(req));
+        net_buf_simple_add_u8(&subevent_bufs[i], BT_DATA_MANUFACTURER_DATA);
+        net_buf_simple_add_mem(&subevent_bufs[i], &req, sizeof(req));
+
+        subevent_params[i].subevent = subevent;
+        subevent_params[i].response_slot_start = 0;
+        subevent_params[i].response_slot_count = HUB_PAWR_SLOTS;
+        subevent_params[i].data = &subevent_bufs[i];
+    }
+
+    err = bt_le_per_adv_set_subevent_data(adv, count, subevent_params);
+    if (err) {
+        LOG_WRN("Failed to set subevent data (err %d)", err);
+    }
+}
+
+static void pawr_response(struct bt_le_ext_adv *adv, struct bt_le_per_adv_response_info *info,
+                          struct net_buf_simple *buf)
+{
+    struct adv_info rsp = { 0 };
+
+    if (!buf || info->subevent >= HUB_PAWR_SUBEVENTS) {
+        return;
+    }
+
+    /* Same layout as a press broadcast, only the frame byte differs */
+    while (buf->len >= 2) {
+        uint8_t len = net_buf_simple_pull_u8(buf);
+        uint8_t type;
+
+        if (len == 0 || len > buf->len) {
+            break;
+        }
+        type = net_buf_simple_pull_u8(buf);
+        if (type == BT_DATA_MANUFACTURER_DATA && len - 1 >= 4) {
+            rsp.mfr = buf->data;
+            rsp.mfr_len = len - 1;
+        }
+        net_buf_simple_pull(buf, len - 1);
+    }
+
+    if (!rsp.mfr || sys_get_le16(rsp.mfr) != ADV_MFR_COMPANY_ID ||
+        rsp.mfr[2] != PAWR_RESPONSE_FRAME) {
+        return;
+    }
+
+    pawr_acks[info->subevent] |= BIT(info->response_slot);
+    ingest(HUB_SOURCE_PAWR, rsp.mfr[3], &rsp.mfr[4], rsp.mfr_len - 4);
+}
+
+static const struct bt_le_ext_adv_cb pawr_callbacks = {
+    .pawr_data_request = pawr_request,
+    .pawr_response = pawr_response,
+};
+
+static int pawr_start(void)
+{
+    const struct bt_le_per_adv_param param = {
+        .interval_min = HUB_PAWR_SUBEVENTS * HUB_PAWR_SUBEVENT_INTERVAL,
+        .interval_max = HUB_PAWR_SUBEVENTS * HUB_PAWR_SUBEVENT_INTERVAL,
+        .options = 0,
+        .num_subevents = HUB_PAWR_SUBEVENTS,
+        .subevent_interval = HUB_PAWR_SUBEVENT_INTERVAL,
+        .response_slot_delay = HUB_PAWR_SLOT_DELAY,
+        .response_slot_spacing = HUB_PAWR_SLOT_SPACING,
+        .num_response_slots = HUB_PAWR_SLOTS,
+    };
+    int err;
+
+    err = bt_le_ext_adv_create(BT_LE_EXT_ADV_NCONN, &pawr_callbacks, &pawr_adv);
+    if (!err) {
+        err = bt_le_ext_adv_set_data(pawr_adv, beacon_ad, ARRAY_SIZE(beacon_ad), NULL, 0);
+    }
+    if (!err) {
+        err = bt_le_per_adv_set_param(pawr_adv, &param);
+    }
+    if (!err) {
+        err = bt_le_per_adv_start(pawr_adv);
+    }
+    if (!err) {
+        err = bt_le_ext_adv_start(pawr_adv, BT_LE_EXT_ADV_START_DEFAULT);
+    }
+    if (err) {
+        LOG_ERR("PAwR train failed to start (err %d)", err);
+        return err;
+    }
+
+    LOG_INF("PAwR train: %u subevents x %u slots", HUB_PAWR_SUBEVENTS, HUB_PAWR_SLOTS);
+    return 0;
+}
+#endif /* CONFIG_BT_PER_ADV_RSP */
+
+int hub_init(void)
+{
+    int err = 0;
+
+    k_work_init_delayable(&merge_work, merge_work_handler);
+
+    /* Capture times for every source */
+    timestamp_start();
+
+#if defined(CONFIG_BT_PER_ADV_RSP)
+    err = pawr_start();
+#endif
+
+    bt_le_scan_cb_register(&scan_callbacks);
+    start_scan();
+
+    LOG_INF("Hub ready for %u connected buzzers", HUB_MAX_BUZZERS);
+    return err;
+}
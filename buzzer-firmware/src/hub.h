@@ -0,0 +1,81 @@
+/**
+ * Hub module (CONFIG_BUZZER_HUB)
+ * 
+ * Build variant in which this board collects the presses of many buzzers
+ * (GATT connections, press broadcasts and a PAwR train) and hands them to the
+ * game client as one stream on the Hub Event characteristic. The first
+ * press of a round is decided here, on the hub's own timer, so the browser's
+ * per-link jitter no longer affects who wins.
+ */
+
+#ifndef HUB_H
+#define HUB_H
+
+#include <zephyr/types.h>
+#include <zephyr/toolchain.h>
+#include <zephyr/bluetooth/conn.h>
+
+#include "press_event.h"
+
+/* Hub event record version */
+#define HUB_EVENT_VERSION  1
+
+/* Where a press reached the hub */
+#define HUB_SOURCE_GATT       0   /* Button Event notification of a connected buzzer */
+#define HUB_SOURCE_BROADCAST  1   /* Press broadcast (CONFIG_BUZZER_BROADCAST buzzers) */
+#define HUB_SOURCE_PAWR       2   /* PAwR response (CONFIG_BUZZER_PAWR buzzers) */
+#define HUB_SOURCE_COUNT      3
+
+/**
+ * Hub event record, notified on the Hub Event characteristic in order of
+ * press_us. Packed little-endian; fields are only appended.
+ */
+struct hub_event {
+    uint8_t  version;           /* HUB_EVENT_VERSION */
+    uint8_t  buzzer_id;         /* Buzzer the press came from */
+    uint8_t  source;            /* HUB_SOURCE_* */
+    uint8_t  rank;              /* Place in the round (1 = first press) */
+    uint32_t capture_us;        /* Hub timer when the press reached the hub */
+    uint32_t press_us;          /* Estimated press time on the hub timer */
+    struct press_event_record record;  /* As sent by the buzzer */
+} __packed;
+
+/**
+ * Start the hub: Hub service, scanning for buzzers and the PAwR train
+ * Call after bt_enable().
+ * 
+ * @return 0 on success, negative errno on failure
+ */
+int hub_init(void);
+
+/**
+ * Set the game state for all buzzers, as written to Hub Control
+ * Arming a new round restarts the ranking at 1.
+ * 
+ * @param state Game state (game_state_t)
+ * @param round_id Round ID
+ * @param winner_id Buzzer that won (state GAME_STATE_WINNER), the others get GAME_STATE_LOCKED
+ */
+void hub_set_game_state(uint8_t state, uint16_t round_id, uint8_t winner_id);
+
+/**
+ * Check whether a connection is one of the hub's links to a buzzer
+ * The connection callbacks of the buzzer modules skip these links, they
+ * only handle the link to the game client.
+ * 
+ * @param conn Connection
+ * @return true for a hub-to-buzzer link, always false outside the hub variant
+ */
+static inline bool hub_is_buzzer_link(struct bt_conn *conn)
+{
+#if defined(CONFIG_BUZZER_HUB)
+    struct bt_conn_info info;
+
+    return bt_conn_get_info(conn, &info) == 0 && info.role == BT_CONN_ROLE_CENTRAL;
+#else
+    ARG_UNUSED(conn);
+    return false;
+#endif
+}
+
+#endif /* HUB_H */
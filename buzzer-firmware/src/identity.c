@@ -0,0 +1,271 @@
+/**
+ * Buzzer identity implementation
+ * 
+ * Stored under the "buzzer" settings subtree (id, color, name) on the NVS
+ * storage partition. Writes happen from the system workqueue, so a GATT
+ * write never blocks the Bluetooth RX thread on a flash erase.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/settings/settings.h>
+#include <string.h>
+
+#include "config.h"
+#include "identity.h"
+#include "button.h"
+#include "led.h"
+#include "advertising.h"
+
+LOG_MODULE_REGISTER(identity, BUZZER_LOG_LEVEL);
+
+/* Button poll interval during local provisioning (longer than the bounce) */
+#define IDENTITY_POLL_MS  25
+
+static struct buzzer_identity identity;
+
+static struct k_work save_work;
+
+/* Provisioning feedback on the buzzer LED */
+static const struct led_pattern provision_mode = {
+    .step_count = 2,
+    .steps = {
+        { .level = 255, .duration_ms = 100 },
+        { .level = 0, .duration_ms = 400 },
+    },
+};
+
+static const struct led_pattern provision_ack = {
+    .step_count = 1,
+    .repeat = 1,
+    .steps = {
+        { .level = 255, .duration_ms = 80 },
+    },
+};
+
+static const struct led_pattern provision_stored = {
+    .step_count = 1,
+    .repeat = 1,
+    .steps = {
+        { .level = 255, .duration_ms = 1000 },
+    },
+};
+
+static void default_name(uint8_t id, char *name)
+{
+    if (id == 1) {
+        strncpy(name, DEVICE_NAME_GREEN, IDENTITY_NAME_MAX);
+    } else if (id == 2) {
+        strncpy(name, DEVICE_NAME_RED, IDENTITY_NAME_MAX);
+    } else {
+        snprintk(name, IDENTITY_NAME_MAX + 1, "%s %u", DEVICE_NAME_PREFIX, id);
+    }
+    name[IDENTITY_NAME_MAX] = '\0';
+}
+
+static void default_color(uint8_t id, uint8_t *color)
+{
+    static const uint8_t green[3] = {0, 255, 0};
+    static const uint8_t red[3] = {255, 0, 0};
+    static const uint8_t white[3] = {255, 255, 255};
+
+    memcpy(color, id == 1 ? green : id == 2 ? red : white, sizeof(identity.color));
+}
+
+/* Settings handler - called for every stored key under "buzzer/" */
+static int identity_settings_set(const char *key, size_t len,
+                                 settings_read_cb read_cb, void *cb_arg)
+{
+    const char *next;
+    ssize_t rc;
+
+    if (settings_name_steq(key, "id", &next) && !next) {
+        if (len != sizeof(identity.id)) {
+            return -EINVAL;
+        }
+        rc = read_cb(cb_arg, &identity.id, sizeof(identity.id));
+        return rc < 0 ? rc : 0;
+    }
+
+    if (settings_name_steq(key, "color", &next) && !next) {
+        if (len != sizeof(identity.color)) {
+            return -EINVAL;
+        }
+        rc = read_cb(cb_arg, identity.color, sizeof(identity.color));
+        return rc < 0 ? rc : 0;
+    }
+
+    if (settings_name_steq(key, "name", &next) && !next) {
+        if (len > IDENTITY_NAME_MAX) {
+            return -EINVAL;
+        }
+        rc = read_cb(cb_arg, identity.name, len);
+        if (rc < 0) {
+            return rc;
+        }
+        identity.name[len] = '\0';
+        return 0;
+    }
+
+    return -ENOENT;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(buzzer_identity, "buzzer", NULL,
+                               identity_settings_set, NULL, NULL);
+
+/* Save work handler - write the identity to flash */
+static void save_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+    int err;
+
+    err = settings_save_one("buzzer/id", &identity.id, sizeof(identity.id));
+    if (!err) {
+        err = settings_save_one("buzzer/color", identity.color, sizeof(identity.color));
+    }
+    if (!err) {
+        err = settings_save_one("buzzer/name", identity.name, strlen(identity.name));
+    }
+
+    if (err) {
+        LOG_ERR("Failed to store identity (err %d)", err);
+        return;
+    }
+
+    LOG_INF("Identity stored: ID %u, \"%s\"", identity.id, identity.name);
+}
+
+int identity_init(void)
+{
+    int err;
+
+    k_work_init(&save_work, save_work_handler);
+
+    identity.id = BUZZER_ID_DEFAULT;
+    identity.name[0] = '\0';
+    default_color(identity.id, identity.color);
+
+    err = settings_subsys_init();
+    if (!err) {
+        err = settings_load_subtree("buzzer");
+    }
+    if (err) {
+        LOG_ERR("Failed to load identity (err %d), using defaults", err);
+    }
+
+    /* Not provisioned yet, or an image without a stored name */
+    if (identity.id == 0) {
+        identity.id = BUZZER_ID_DEFAULT;
+    }
+    if (identity.name[0] == '\0') {
+        default_name(identity.id, identity.name);
+    }
+
+    LOG_INF("Identity: ID %u, \"%s\", colour #%02x%02x%02x", identity.id,
+            identity.name, identity.color[0], identity.color[1], identity.color[2]);
+    return err;
+}
+
+const struct buzzer_identity *identity_get(void)
+{
+    return &identity;
+}
+
+int identity_set(uint8_t id, const uint8_t *color, const char *name)
+{
+    int err;
+
+    if (id == 0 || (name && strlen(name) > IDENTITY_NAME_MAX)) {
+        return -EINVAL;
+    }
+
+    identity.id = id;
+    if (color) {
+        memcpy(identity.color, color, sizeof(identity.color));
+    } else {
+        default_color(id, identity.color);
+    }
+    if (name && name[0] != '\0') {
+        strcpy(identity.name, name);
+    } else {
+        default_name(id, identity.name);
+    }
+
+    /* Used for the scan response from the next advertising start on */
+    if (bt_is_ready()) {
+        err = bt_set_name(identity.name);
+        if (err) {
+            LOG_ERR("Failed to set Bluetooth device name (err %d)", err);
+        }
+        advertising_update_data();
+    }
+
+    k_work_submit(&save_work);
+    return 0;
+}
+
+/* Wait until the button is released or held for IDENTITY_HOLD_MS
+ * Returns true for a hold.
+ */
+static bool wait_release_or_hold(void)
+{
+    int64_t start = k_uptime_get();
+
+    while (button_is_pressed()) {
+        if (k_uptime_get() - start >= IDENTITY_HOLD_MS) {
+            return true;
+        }
+        k_msleep(IDENTITY_POLL_MS);
+    }
+
+    return false;
+}
+
+static void wait_release(void)
+{
+    while (button_is_pressed()) {
+        k_msleep(IDENTITY_POLL_MS);
+    }
+}
+
+void identity_provision_local(void)
+{
+    uint8_t id = identity.id;
+    int64_t last_press;
+
+    if (!button_is_pressed() || !wait_release_or_hold()) {
+        return;
+    }
+
+    LOG_INF("Provisioning: short press = next ID, hold %u ms = store (ID %u)",
+            IDENTITY_HOLD_MS, id);
+    /* Slow blink for the whole session, the acknowledge flashes return to it */
+    led_set_idle(LED_BUZZER, &provision_mode);
+    led_resume(LED_BUZZER);
+    wait_release();
+
+    last_press = k_uptime_get();
+    while (k_uptime_get() - last_press < IDENTITY_PROVISION_TIMEOUT_MS) {
+        if (!button_is_pressed()) {
+            k_msleep(IDENTITY_POLL_MS);
+            continue;
+        }
+
+        if (wait_release_or_hold()) {
+            identity_set(id, NULL, NULL);
+            led_set_idle(LED_BUZZER, NULL);
+            led_play(LED_BUZZER, &provision_stored);
+            wait_release();
+            return;
+        }
+
+        id = (id == UINT8_MAX) ? 1 : id + 1;
+        led_play(LED_BUZZER, &provision_ack);
+        LOG_INF("Provisioning: ID %u", id);
+        last_press = k_uptime_get();
+    }
+
+    led_set_idle(LED_BUZZER, NULL);
+    LOG_INF("Provisioning timed out, keeping ID %u", identity.id);
+}
@@ -0,0 +1,65 @@
+/**
+ * Buzzer identity module
+ * 
+ * The buzzer ID (1-255), display name and colour are stored in flash through
+ * the settings subsystem, so one firmware image serves every buzzer. A buzzer
+ * is provisioned over the Identity characteristic or by holding the button
+ * at boot; until then it uses BUZZER_ID_DEFAULT.
+ */
+
+#ifndef IDENTITY_H
+#define IDENTITY_H
+
+#include <zephyr/types.h>
+
+#include "config.h"
+
+/**
+ * Stored identity
+ */
+struct buzzer_identity {
+    uint8_t id;                           /* 1-255 */
+    uint8_t color[3];                     /* RGB, shown by the game client */
+    char name[IDENTITY_NAME_MAX + 1];     /* Bluetooth device name */
+};
+
+/**
+ * Load the stored identity (or the defaults) from flash
+ * Call before bt_enable().
+ * 
+ * @return 0 on success, negative errno on failure (defaults are used)
+ */
+int identity_init(void);
+
+/**
+ * Get the current identity
+ * 
+ * @return Identity, valid for the lifetime of the firmware
+ */
+const struct buzzer_identity *identity_get(void);
+
+/**
+ * Set, store and apply a new identity
+ * The device name takes effect the next time advertising starts. The flash
+ * write happens in the background on the system workqueue; a failure is
+ * logged and the identity stays in effect until reset.
+ * 
+ * @param id Buzzer ID (1-255)
+ * @param color RGB colour, or NULL for the default colour of the ID
+ * @param name Device name, or NULL/empty for the default name of the ID
+ * @return 0 on success, -EINVAL for ID 0 or a name that is too long
+ */
+int identity_set(uint8_t id, const uint8_t *color, const char *name);
+
+/**
+ * Local provisioning by holding the button at boot
+ * Returns at once unless the button is held for IDENTITY_HOLD_MS. Then each
+ * short press steps the ID by one (acknowledged by a flash of the buzzer
+ * LED), and holding the button for IDENTITY_HOLD_MS again stores it with
+ * the default name and colour of the new ID. Gives up without storing
+ * after IDENTITY_PROVISION_TIMEOUT_MS without a press.
+ * Call after led_init() and before button_init() (polls the pin).
+ */
+void identity_provision_local(void);
+
+#endif /* IDENTITY_H */
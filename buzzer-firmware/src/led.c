@@ -1,66 +1,367 @@
 /**
  * LED control implementation
- * Simple on/off control using a single GPIO pin (P0.13)
+ * PWM sequencer for the status LED (P0.15) and buzzer LED (P0.06)
+ * 
+ * Each LED has its own PWM instance. The lit part of a pattern (first to
+ * last step with a level above 0) is expanded once into a buffer of duty
+ * cycles, one per LED_PWM_STEP_MS or longer, and handed to the PWM
+ * peripheral, which fetches it by EasyDMA and plays it with the CPU asleep.
+ * 
+ * The PWM keeps the 16 MHz clock running while it plays, so it only plays
+ * lit parts. The dark steps before and after them are a k_timer with the
+ * PWM stopped: a 50 ms status blink every 5 s runs the PWM for 50 ms and
+ * wakes the CPU twice per blink (end of the flash, end of the gap). Only a
+ * pattern without dark steps at either end is looped by the peripheral
+ * itself, without events. An LED that is dark (level 0 held, or no idle
+ * pattern) stops its PWM. A spinlock serializes the API calls against the
+ * PWM interrupt and the gap timer.
  */
 
 #include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
 #include <zephyr/device.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/spinlock.h>
+#include <nrfx_pwm.h>
 
 #include "config.h"
 #include "led.h"
 
-/* Use direct GPIO reference */
-#define LED_GPIO_PORT DT_NODELABEL(gpio0)
-static const struct device *gpio_dev = NULL;
+LOG_MODULE_REGISTER(led, BUZZER_LOG_LEVEL);
 
-/* Auto-off timer for power saving */
-static struct k_timer led_auto_off_timer;
-/* Commented out unused variable to suppress warning */
-// static bool auto_off_enabled = false;
+/* Duty cycle polarity bit: set = output high for COMPARE counts of the period */
+#define PWM_HIGH_FIRST  0x8000
 
-/* Timer callback to turn off LED */
-static void led_auto_off_handler(struct k_timer *timer)
+/* PWM period with the 1 MHz base clock */
+#define PWM_PERIOD_US  LED_PWM_TOP
+
+struct led_channel {
+    nrfx_pwm_t pwm;
+    uint32_t psel;                      /* Output pin */
+    bool lit_high;                      /* LED lights when the pin is high */
+    struct led_pattern idle;            /* Looped when nothing else plays */
+    struct led_pattern active;          /* One-shot pattern or held level */
+    const struct led_pattern *current;  /* &idle or &active */
+    bool holding;                       /* Current pattern ends on a held step */
+    bool timed;                         /* Passes of the lit part timed by gap_timer */
+    bool hold_lit;                      /* The held step is lit (keep the PWM running) */
+    uint8_t passes;                     /* Passes to play when timed, 0 = loop */
+    uint8_t played;                     /* Passes played when timed */
+    uint32_t lead_ms;                   /* Dark steps before the lit part */
+    uint32_t tail_ms;                   /* Dark steps after the lit part */
+    struct k_timer gap_timer;           /* Dark steps, PWM stopped */
+    nrf_pwm_sequence_t seq;             /* Lit part, replayed every pass */
+    uint8_t buf;                        /* Buffer the next sequence is built in */
+    nrf_pwm_values_common_t values[2][LED_PWM_SEQ_LEN];  /* EasyDMA, double buffered */
+};
+
+/* inv: the LED lights at the opposite of its devicetree logical level */
+#define LED_CHANNEL(alias, inst, inv) {                                     \
+    .pwm = NRFX_PWM_INSTANCE(inst),                                         \
+    .psel = NRF_DT_GPIOS_TO_PSEL(DT_ALIAS(alias), gpios),                   \
+    .lit_high = ((DT_GPIO_FLAGS(DT_ALIAS(alias), gpios) & GPIO_ACTIVE_LOW) == 0) != inv, \
+}
+
+static struct led_channel channels[LED_COUNT] = {
+    /* The status LED has always been lit at logical 0 on this board */
+    [LED_STATUS] = LED_CHANNEL(led0, LED_PWM_STATUS_INSTANCE, true),
+    [LED_BUZZER] = LED_CHANNEL(led1, LED_PWM_BUZZER_INSTANCE, false),
+};
+
+static struct k_spinlock lock;
+
+/* Percentage applied to every level (battery saving) */
+static uint8_t brightness_scale = LED_BRIGHTNESS_DEFAULT_PERCENT;
+
+/* Level 0-255 to a duty cycle value for the channel */
+static nrf_pwm_values_common_t level_to_duty(const struct led_channel *ch, uint8_t level)
 {
-    ARG_UNUSED(timer);
-    led_off();
+    uint32_t compare = (uint32_t)level * brightness_scale * LED_PWM_TOP / (255 * 100);
+
+    return compare | (ch->lit_high ? PWM_HIGH_FIRST : 0);
 }
 
-int led_init(void)
+/* Play the lit part once; the PWM stops after it unless a lit step is held */
+static void play_pass(struct led_channel *ch)
+{
+    nrfx_pwm_simple_playback(&ch->pwm, &ch->seq, 1,
+                             ch->hold_lit ? 0 : NRFX_PWM_FLAG_STOP);
+}
+
+/* Expand a pattern into the channel's free buffer and start playing it */
+static void start_pattern(struct led_channel *ch, const struct led_pattern *pattern,
+                          uint8_t loops)
 {
-    int ret;
+    nrf_pwm_values_common_t *values = ch->values[ch->buf];
+    uint32_t total_ms = 0;
+    uint32_t quantum_ms;
+    uint16_t len = 0;
+    uint8_t steps = pattern->step_count;
+    int first_lit = -1;
+    int last_lit = -1;
 
-    /* Get GPIO device */
-    gpio_dev = DEVICE_DT_GET(LED_GPIO_PORT);
-    if (!device_is_ready(gpio_dev)) {
-        printk("GPIO device not ready\n");
-        return -ENODEV;
+    k_timer_stop(&ch->gap_timer);
+    ch->current = pattern;
+    ch->holding = false;
+    ch->lead_ms = 0;
+    ch->tail_ms = 0;
+
+    /* A step with duration 0 is held and ends the pattern */
+    for (int i = 0; i < pattern->step_count; i++) {
+        if (pattern->steps[i].level != 0) {
+            if (first_lit < 0) {
+                first_lit = i;
+            }
+            last_lit = i;
+        }
+        if (pattern->steps[i].duration_ms == 0) {
+            steps = i + 1;
+            ch->holding = true;
+            break;
+        }
+    }
+
+    /* Dark (no pattern, or only level 0): stop, the pin idles with the LED off */
+    if (first_lit < 0) {
+        nrfx_pwm_stop(&ch->pwm, false);
+        return;
     }
 
-    /* Configure LED pin as output, initially off */
-    ret = gpio_pin_configure(gpio_dev, BUZZER_LED_PIN, GPIO_OUTPUT_INACTIVE);
-    if (ret < 0) {
-        printk("Failed to configure LED pin %d\n", BUZZER_LED_PIN);
-        return ret;
+    for (int i = 0; i < steps; i++) {
+        uint32_t duration_ms = pattern->steps[i].duration_ms;
+
+        if (i < first_lit) {
+            ch->lead_ms += duration_ms;
+        } else if (i > last_lit) {
+            ch->tail_ms += duration_ms;
+        } else {
+            total_ms += duration_ms;
+        }
     }
 
-    /* Initialize auto-off timer */
-    k_timer_init(&led_auto_off_timer, led_auto_off_handler, NULL);
+    /* One duty value per quantum; leave room for rounding up every step */
+    quantum_ms = MAX(LED_PWM_STEP_MS,
+                     DIV_ROUND_UP(total_ms, LED_PWM_SEQ_LEN - LED_PATTERN_MAX_STEPS));
+
+    for (int i = first_lit; i <= last_lit; i++) {
+        const struct led_step *s = &pattern->steps[i];
+        uint32_t n = MAX(1, DIV_ROUND_CLOSEST(s->duration_ms, quantum_ms));
+        nrf_pwm_values_common_t duty = level_to_duty(ch, s->level);
+
+        for (uint32_t j = 0; j < n && len < LED_PWM_SEQ_LEN; j++) {
+            values[len++] = duty;
+        }
+    }
+
+    ch->seq = (nrf_pwm_sequence_t) {
+        .values = { .p_common = values },
+        .length = len,
+        .repeats = quantum_ms * 1000 / PWM_PERIOD_US - 1,
+        .end_delay = 0,
+    };
+    ch->buf ^= 1;
+    ch->hold_lit = ch->holding && last_lit == steps - 1;
+    ch->timed = ch->lead_ms || ch->tail_ms || last_lit != steps - 1;
+
+    if (ch->timed) {
+        /* Dark steps at either end: one pass of the lit part at a time */
+        ch->passes = ch->holding ? 1 : loops;
+        ch->played = 0;
+        if (ch->lead_ms) {
+            nrfx_pwm_stop(&ch->pwm, false);
+            k_timer_start(&ch->gap_timer, K_MSEC(ch->lead_ms), K_NO_WAIT);
+        } else {
+            play_pass(ch);
+        }
+    } else if (ch->holding) {
+        /* Play once; the peripheral keeps outputting the last (held) value */
+        nrfx_pwm_simple_playback(&ch->pwm, &ch->seq, 1, 0);
+    } else if (loops == 0) {
+        /* Lit throughout: looped by the peripheral, no event per pass */
+        nrfx_pwm_simple_playback(&ch->pwm, &ch->seq, 1,
+                                 NRFX_PWM_FLAG_LOOP | NRFX_PWM_FLAG_NO_EVT_FINISHED);
+    } else {
+        nrfx_pwm_simple_playback(&ch->pwm, &ch->seq, loops, 0);
+    }
+}
 
-    printk("LED initialized on pin P0.%d\n", BUZZER_LED_PIN);
+/* Pattern done - a one-shot pattern falls back to idle */
+static void pattern_done(struct led_channel *ch)
+{
+    if (ch->current == &ch->active && !ch->holding) {
+        start_pattern(ch, &ch->idle, 0);
+    }
+}
+
+/* PWM playback finished - time the dark steps, or end a one-shot pattern */
+static void pwm_handler(nrfx_pwm_evt_type_t event_type, void *context)
+{
+    struct led_channel *ch = context;
+
+    if (event_type != NRFX_PWM_EVT_FINISHED) {
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    /* A held step plays on, or the LED stays dark with the PWM stopped */
+    if (!ch->timed) {
+        pattern_done(ch);
+    } else if (!ch->holding) {
+        /* Dark steps of this pass, and of the next one unless this was the last */
+        bool last = ch->passes && ++ch->played == ch->passes;
+        uint32_t gap_ms = ch->tail_ms + (last ? 0 : ch->lead_ms);
+
+        k_timer_start(&ch->gap_timer, K_MSEC(gap_ms), K_NO_WAIT);
+    }
+
+    k_spin_unlock(&lock, key);
+}
+
+/* Gap timer expired - the dark steps are over, play the next pass */
+static void gap_timer_handler(struct k_timer *timer)
+{
+    struct led_channel *ch = k_timer_user_data_get(timer);
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (ch->passes && ch->played == ch->passes) {
+        pattern_done(ch);
+    } else {
+        play_pass(ch);
+    }
+
+    k_spin_unlock(&lock, key);
+}
+
+/* Copy a pattern, clamping the step count */
+static void copy_pattern(struct led_pattern *dst, const struct led_pattern *src)
+{
+    if (!src) {
+        dst->step_count = 0;
+        dst->repeat = 0;
+        return;
+    }
+
+    *dst = *src;
+    dst->step_count = MIN(src->step_count, LED_PATTERN_MAX_STEPS);
+}
+
+int led_init(void)
+{
+    IRQ_CONNECT(NRFX_IRQ_NUMBER_GET(NRF_PWM_INST_GET(LED_PWM_STATUS_INSTANCE)),
+                IRQ_PRIO_LOWEST, nrfx_isr,
+                NRFX_PWM_INST_HANDLER_GET(LED_PWM_STATUS_INSTANCE), 0);
+    IRQ_CONNECT(NRFX_IRQ_NUMBER_GET(NRF_PWM_INST_GET(LED_PWM_BUZZER_INSTANCE)),
+                IRQ_PRIO_LOWEST, nrfx_isr,
+                NRFX_PWM_INST_HANDLER_GET(LED_PWM_BUZZER_INSTANCE), 0);
+
+    for (int i = 0; i < LED_COUNT; i++) {
+        struct led_channel *ch = &channels[i];
+        nrfx_pwm_config_t cfg = NRFX_PWM_DEFAULT_CONFIG(
+            ch->psel | (ch->lit_high ? 0 : NRFX_PWM_PIN_INVERTED),
+            NRF_PWM_PIN_NOT_CONNECTED, NRF_PWM_PIN_NOT_CONNECTED,
+            NRF_PWM_PIN_NOT_CONNECTED);
+
+        cfg.base_clock = NRF_PWM_CLK_1MHz;
+        cfg.count_mode = NRF_PWM_MODE_UP;
+        cfg.top_value = LED_PWM_TOP;
+        cfg.load_mode = NRF_PWM_LOAD_COMMON;
+        cfg.step_mode = NRF_PWM_STEP_AUTO;
+
+        if (nrfx_pwm_init(&ch->pwm, &cfg, pwm_handler, ch) != NRFX_SUCCESS) {
+            LOG_ERR("Failed to initialize PWM for LED %d", i);
+            return -EBUSY;
+        }
+
+        k_timer_init(&ch->gap_timer, gap_timer_handler, NULL);
+        k_timer_user_data_set(&ch->gap_timer, ch);
+
+        copy_pattern(&ch->idle, NULL);
+        start_pattern(ch, &ch->idle, 0);
+    }
+
+    LOG_INF("LEDs initialized on PWM%d (status, P0.%d) and PWM%d (buzzer, P0.%d)",
+            LED_PWM_STATUS_INSTANCE, DT_GPIO_PIN(DT_ALIAS(led0), gpios),
+            LED_PWM_BUZZER_INSTANCE, DT_GPIO_PIN(DT_ALIAS(led1), gpios));
     return 0;
 }
 
-void led_on(void)
+void led_set_idle(led_id_t led, const struct led_pattern *pattern)
 {
-    if (gpio_dev) {
-        gpio_pin_set(gpio_dev, BUZZER_LED_PIN, 1);
+    struct led_channel *ch = &channels[led];
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    copy_pattern(&ch->idle, pattern);
+    if (ch->current == &ch->idle) {
+        start_pattern(ch, &ch->idle, 0);
     }
+
+    k_spin_unlock(&lock, key);
 }
 
-void led_off(void)
+void led_play(led_id_t led, const struct led_pattern *pattern)
+{
+    struct led_channel *ch = &channels[led];
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    copy_pattern(&ch->active, pattern);
+    start_pattern(ch, &ch->active, ch->active.repeat);
+
+    k_spin_unlock(&lock, key);
+}
+
+void led_set(led_id_t led, uint8_t level)
+{
+    struct led_channel *ch = &channels[led];
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    ch->active.step_count = 1;
+    ch->active.repeat = 0;
+    ch->active.steps[0].level = level;
+    ch->active.steps[0].duration_ms = 0;
+    start_pattern(ch, &ch->active, 0);
+
+    k_spin_unlock(&lock, key);
+}
+
+void led_resume(led_id_t led)
 {
-    if (gpio_dev) {
-        gpio_pin_set(gpio_dev, BUZZER_LED_PIN, 0);
+    struct led_channel *ch = &channels[led];
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    start_pattern(ch, &ch->idle, 0);
+
+    k_spin_unlock(&lock, key);
+}
+
+void led_set_brightness_scale(uint8_t percent)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (percent == brightness_scale) {
+        k_spin_unlock(&lock, key);
+        return;
+    }
+    brightness_scale = MIN(percent, 100);
+
+    /* Idle patterns pick the new scale up at once, others when they restart */
+    for (int i = 0; i < LED_COUNT; i++) {
+        if (channels[i].current == &channels[i].idle) {
+            start_pattern(&channels[i], &channels[i].idle, 0);
+        }
     }
+
+    k_spin_unlock(&lock, key);
+
+    LOG_INF("LED brightness scale: %u%%", percent);
+}
+
+void led_on(void)
+{
+    led_set(LED_BUZZER, UINT8_MAX);
+}
+
+void led_off(void)
+{
+    led_resume(LED_BUZZER);
 }
@@ -1,5 +1,12 @@
 /**
  * LED control module
+ * 
+ * Non-blocking sequencer that owns the status LED and the buzzer LED.
+ * Every LED plays an idle pattern (looped, e.g. the status blink) and can be
+ * overridden by a one-shot pattern or a held level. The lit parts of a
+ * pattern are played by the PWM peripheral from RAM and the dark parts are
+ * timed with the PWM stopped, so no caller ever sleeps and the CPU only
+ * wakes where a dark part begins or ends.
  */
 
 #ifndef LED_H
@@ -7,6 +14,34 @@
 
 #include <zephyr/types.h>
 
+#include "config.h"
+
+/**
+ * LEDs driven by the sequencer
+ */
+typedef enum {
+    LED_STATUS = 0,  /* Onboard status LED (led0) */
+    LED_BUZZER = 1,  /* External buzzer LED (led1) */
+    LED_COUNT
+} led_id_t;
+
+/**
+ * One pattern step: hold a level for a duration
+ */
+struct led_step {
+    uint8_t level;         /* Brightness 0-255 */
+    uint16_t duration_ms;  /* Time to hold the level, 0 = hold until replaced */
+};
+
+/**
+ * Sequence of steps played repeat times (0 = loop forever)
+ */
+struct led_pattern {
+    uint8_t step_count;
+    uint8_t repeat;
+    struct led_step steps[LED_PATTERN_MAX_STEPS];
+};
+
 /**
  * Initialize LED GPIO pins
  * 
@@ -15,12 +50,52 @@
 int led_init(void);
 
 /**
- * Turn on LED
+ * Set the pattern an LED returns to when nothing else is playing
+ * 
+ * @param led LED to configure
+ * @param pattern Pattern to loop (copied, repeat is ignored), NULL for off
+ */
+void led_set_idle(led_id_t led, const struct led_pattern *pattern);
+
+/**
+ * Play a pattern once (repeat times), then return to the idle pattern
+ * A looping pattern (repeat 0) plays until led_resume() or another call.
+ * 
+ * @param led LED to drive
+ * @param pattern Pattern to play (copied)
+ */
+void led_play(led_id_t led, const struct led_pattern *pattern);
+
+/**
+ * Hold a level until led_play(), led_set() or led_resume() is called
+ * 
+ * @param led LED to drive
+ * @param level Brightness 0-255
+ */
+void led_set(led_id_t led, uint8_t level);
+
+/**
+ * Stop the current pattern or held level and return to the idle pattern
+ * 
+ * @param led LED to release
+ */
+void led_resume(led_id_t led);
+
+/**
+ * Scale all LED levels, e.g. to save battery
+ * Idle patterns change at once, other patterns when they are next started.
+ * 
+ * @param percent Brightness in percent of the requested levels (0-100)
+ */
+void led_set_brightness_scale(uint8_t percent);
+
+/**
+ * Turn on the buzzer LED (held until led_off())
  */
 void led_on(void);
 
 /**
- * Turn off LED
+ * Turn off the buzzer LED (returns it to its idle pattern)
  */
 void led_off(void);
 
@@ -0,0 +1,586 @@
+/**
+ * Link policy implementation
+ * 
+ * Parameter updates are issued from the system workqueue (never from a
+ * Bluetooth callback). The requested profile is re-applied when the central
+ * or the stack's automatic update moves the link away from it, up to
+ * LINK_MAX_ATTEMPTS times per request so a central that insists on its own
+ * parameters is not asked forever.
+ * 
+ * PHY policy: 2M is requested right after connecting (half the air time of
+ * 1M per packet). Every LINK_QUALITY_PERIOD_MS the controller's QoS
+ * connection event reports are enabled for a short window to measure the
+ * packet error rate, and the RSSI is read. A marginal link falls back one
+ * step (2M -> 1M -> Coded S8); it moves back up only after
+ * LINK_PHY_UPGRADE_WINDOWS good windows with an RSSI margin. A PHY the
+ * central refused is not requested again on this connection.
+ * 
+ * The idle profile uses peripheral latency. The connection event counter
+ * of src/timestamp.c only counts the events this side takes part in, so
+ * while the link runs with latency link_anchors_valid() is false; presses
+ * are gated outside armed anyway. Once latency is back to 0 (armed) the
+ * counter is restarted and anchors are valid again: the host sees the new
+ * interval, or the count going backwards, and starts a new fit.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/hci_vs.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <sdc_hci_vs.h>
+
+#include "config.h"
+#include "link.h"
+#include "hub.h"
+#include "timestamp.h"
+
+LOG_MODULE_REGISTER(link, BUZZER_LOG_LEVEL);
+
+#define LINK_MAX_ATTEMPTS  3
+#define LINK_RETRY_MS      1000
+
+/* Fewer connection events than this in a window (peripheral latency) give
+ * no usable packet error rate; the RSSI alone decides then
+ */
+#define LINK_QUALITY_MIN_EVENTS  10
+
+#define PHY_MASK(phy)  BIT(phy)
+
+static struct bt_conn *link_conn = NULL;
+static link_mode_t mode = LINK_MODE_IDLE;
+static bool mode_set = false;     /* Host requested a mode on this link */
+static uint8_t attempts;
+
+/* Parameters the connection currently runs with */
+static uint16_t cur_interval;
+static uint16_t cur_latency;
+static uint16_t cur_timeout;
+
+/* No connection event was skipped on this link so far */
+static bool anchors_valid;
+
+/* Switch-over timing */
+static int64_t request_ms;        /* Uptime of the pending request, 0 = none */
+static uint16_t switch_ms;
+
+/* PHY policy state */
+static uint8_t cur_phy = BT_GAP_LE_PHY_1M;
+static uint8_t requested_phy;     /* 0 = no PHY update pending */
+static uint8_t refused_phys;      /* PHY_MASK() of PHYs the central refused */
+static uint8_t good_windows;
+static int8_t rssi = LINK_RSSI_UNKNOWN;
+static uint16_t per_permille;
+static uint16_t phy_fallbacks;
+static bool sampling;             /* QoS reports enabled */
+static uint16_t conn_handle;
+
+/* Filled by the QoS report callback (Bluetooth RX thread) */
+static atomic_t window_events;
+static atomic_t window_errors;
+
+static struct k_work_delayable apply_work;
+static struct k_work_delayable idle_work;
+static struct k_work_delayable phy_work;
+static struct k_work_delayable quality_work;
+static struct k_work qos_off_work;
+
+static const char *mode_name(link_mode_t m)
+{
+    return m == LINK_MODE_ARMED ? "armed" : "idle";
+}
+
+static bool params_match(void)
+{
+    if (mode == LINK_MODE_ARMED) {
+        return cur_interval == LINK_ARMED_INTERVAL && cur_latency == LINK_ARMED_LATENCY;
+    }
+
+    return cur_interval >= LINK_IDLE_INTERVAL_MIN && cur_interval <= LINK_IDLE_INTERVAL_MAX &&
+           cur_latency == LINK_IDLE_LATENCY;
+}
+
+/* Apply work handler - request the parameters of the current mode */
+static void apply_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+    struct bt_le_conn_param param;
+    int err;
+
+    if (!link_conn || !mode_set) {
+        return;
+    }
+
+    if (params_match()) {
+        /* Already running with this profile */
+        if (request_ms) {
+            switch_ms = 0;
+            request_ms = 0;
+        }
+        return;
+    }
+
+    if (attempts >= LINK_MAX_ATTEMPTS) {
+        LOG_WRN("Central keeps interval %u latency %u, giving up on %s mode",
+                cur_interval, cur_latency, mode_name(mode));
+        request_ms = 0;
+        return;
+    }
+    attempts++;
+
+    if (mode == LINK_MODE_ARMED) {
+        param = (struct bt_le_conn_param)BT_LE_CONN_PARAM_INIT(
+            LINK_ARMED_INTERVAL, LINK_ARMED_INTERVAL,
+            LINK_ARMED_LATENCY, LINK_ARMED_TIMEOUT);
+    } else {
+        param = (struct bt_le_conn_param)BT_LE_CONN_PARAM_INIT(
+            LINK_IDLE_INTERVAL_MIN, LINK_IDLE_INTERVAL_MAX,
+            LINK_IDLE_LATENCY, LINK_IDLE_TIMEOUT);
+    }
+
+    err = bt_conn_le_param_update(link_conn, &param);
+    if (err && err != -EALREADY) {
+        /* Another procedure is still running, try again */
+        LOG_WRN("Connection parameter update failed (err %d), retrying", err);
+        k_work_reschedule(&apply_work, K_MSEC(LINK_RETRY_MS));
+    }
+}
+
+/* Idle work handler - the delayed switch to idle */
+static void idle_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    if (mode_set && mode == LINK_MODE_IDLE) {
+        return;
+    }
+
+    mode = LINK_MODE_IDLE;
+    mode_set = true;
+    attempts = 0;
+    request_ms = k_uptime_get();
+    k_work_reschedule(&apply_work, K_NO_WAIT);
+}
+
+static const char *phy_name(uint8_t phy)
+{
+    switch (phy) {
+    case BT_GAP_LE_PHY_2M:
+        return "2M";
+    case BT_GAP_LE_PHY_CODED:
+        return "Coded";
+    default:
+        return "1M";
+    }
+}
+
+/* PHY work handler - request requested_phy for both directions */
+static void phy_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+    struct bt_conn_le_phy_param param = {
+        .options = BT_CONN_LE_PHY_OPT_NONE,
+        .pref_tx_phy = BT_GAP_LE_PHY_1M,
+        .pref_rx_phy = BT_GAP_LE_PHY_1M,
+    };
+    int err;
+
+    if (!link_conn || !requested_phy) {
+        return;
+    }
+
+    if (requested_phy == BT_GAP_LE_PHY_2M) {
+        param.pref_tx_phy = BT_GAP_LE_PHY_2M;
+        param.pref_rx_phy = BT_GAP_LE_PHY_2M;
+    } else if (requested_phy == BT_GAP_LE_PHY_CODED) {
+        /* S8 coding: longest range, used only as the last fallback */
+        param.options = BT_CONN_LE_PHY_OPT_CODED_S8;
+        param.pref_tx_phy = BT_GAP_LE_PHY_CODED;
+        param.pref_rx_phy = BT_GAP_LE_PHY_CODED;
+    }
+
+    err = bt_conn_le_phy_update(link_conn, &param);
+    if (err) {
+        LOG_WRN("PHY update to %s failed (err %d)", phy_name(requested_phy), err);
+        requested_phy = 0;
+    }
+}
+
+static void request_phy(uint8_t phy)
+{
+    if (phy == cur_phy || (refused_phys & PHY_MASK(phy))) {
+        return;
+    }
+
+    requested_phy = phy;
+    k_work_reschedule(&phy_work, K_NO_WAIT);
+}
+
+/* Vendor event callback (Bluetooth RX thread) - count QoS reports */
+static bool qos_report_cb(struct net_buf_simple *buf)
+{
+    const sdc_hci_subevent_vs_qos_conn_event_report_t *evt;
+    uint8_t code;
+
+    if (buf->len < sizeof(code) + sizeof(*evt)) {
+        return false;
+    }
+
+    code = net_buf_simple_pull_u8(buf);
+    if (code != SDC_HCI_SUBEVENT_VS_QOS_CONN_EVENT_REPORT) {
+        return false;
+    }
+
+    evt = (const void *)buf->data;
+    if (sys_le16_to_cpu(evt->conn_handle) != conn_handle) {
+        return true;
+    }
+
+    /* A connection event is bad if a packet failed its CRC or none arrived */
+    atomic_inc(&window_events);
+    if (evt->rx_crc_error_count > 0 || evt->rx_packet_count == 0) {
+        atomic_inc(&window_errors);
+    }
+
+    return true;
+}
+
+static int qos_report_enable(bool enable)
+{
+    sdc_hci_cmd_vs_qos_conn_event_report_enable_t *cp;
+    struct net_buf *buf;
+
+    buf = bt_hci_cmd_create(SDC_HCI_OPCODE_CMD_VS_QOS_CONN_EVENT_REPORT_ENABLE, sizeof(*cp));
+    if (!buf) {
+        return -ENOBUFS;
+    }
+
+    cp = net_buf_add(buf, sizeof(*cp));
+    cp->enable = enable;
+
+    return bt_hci_cmd_send_sync(SDC_HCI_OPCODE_CMD_VS_QOS_CONN_EVENT_REPORT_ENABLE, buf, NULL);
+}
+
+static int read_rssi(int8_t *value)
+{
+    struct bt_hci_cp_read_rssi *cp;
+    struct bt_hci_rp_read_rssi *rp;
+    struct net_buf *buf, *rsp = NULL;
+    int err;
+
+    buf = bt_hci_cmd_create(BT_HCI_OP_READ_RSSI, sizeof(*cp));
+    if (!buf) {
+        return -ENOBUFS;
+    }
+
+    cp = net_buf_add(buf, sizeof(*cp));
+    cp->handle = sys_cpu_to_le16(conn_handle);
+
+    err = bt_hci_cmd_send_sync(BT_HCI_OP_READ_RSSI, buf, &rsp);
+    if (err) {
+        return err;
+    }
+
+    rp = (void *)rsp->data;
+    *value = rp->rssi;
+    net_buf_unref(rsp);
+    return 0;
+}
+
+/* QoS off work handler - disable reports left on by a dropped connection */
+static void qos_off_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    if (!link_conn) {
+        qos_report_enable(false);
+    }
+}
+
+/* Pick the PHY for the measured RSSI and packet error rate */
+static uint8_t choose_phy(bool per_valid)
+{
+    bool bad = per_valid && per_permille > LINK_PHY_PER_MAX_PERMILLE;
+    bool good = per_valid && per_permille <= LINK_PHY_PER_OK_PERMILLE;
+    bool known = rssi != LINK_RSSI_UNKNOWN;
+
+    switch (cur_phy) {
+    case BT_GAP_LE_PHY_2M:
+        if (bad || (known && rssi < LINK_PHY_RSSI_2M_MIN)) {
+            return BT_GAP_LE_PHY_1M;
+        }
+        break;
+    case BT_GAP_LE_PHY_1M:
+        if (bad || (known && rssi < LINK_PHY_RSSI_1M_MIN)) {
+            return BT_GAP_LE_PHY_CODED;
+        }
+        if (good && known && rssi >= LINK_PHY_RSSI_2M_MIN + LINK_PHY_RSSI_HYSTERESIS &&
+            good_windows >= LINK_PHY_UPGRADE_WINDOWS) {
+            return BT_GAP_LE_PHY_2M;
+        }
+        break;
+    case BT_GAP_LE_PHY_CODED:
+        if (good && known && rssi >= LINK_PHY_RSSI_1M_MIN + LINK_PHY_RSSI_HYSTERESIS &&
+            good_windows >= LINK_PHY_UPGRADE_WINDOWS) {
+            return BT_GAP_LE_PHY_1M;
+        }
+        break;
+    }
+
+    return cur_phy;
+}
+
+/* Quality work handler - alternates between opening a QoS window and
+ * evaluating it
+ */
+static void quality_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+    uint32_t events, errors;
+    bool per_valid;
+    uint8_t phy;
+
+    if (!link_conn) {
+        return;
+    }
+
+    if (!sampling) {
+        atomic_clear(&window_events);
+        atomic_clear(&window_errors);
+        sampling = (qos_report_enable(true) == 0);
+        k_work_reschedule(&quality_work, K_MSEC(sampling ? LINK_QUALITY_WINDOW_MS
+                                                          : LINK_QUALITY_PERIOD_MS));
+        return;
+    }
+
+    qos_report_enable(false);
+    sampling = false;
+
+    events = atomic_get(&window_events);
+    errors = atomic_get(&window_errors);
+    per_valid = events >= LINK_QUALITY_MIN_EVENTS;
+    if (per_valid) {
+        per_permille = errors * 1000 / events;
+    }
+
+    if (read_rssi(&rssi)) {
+        rssi = LINK_RSSI_UNKNOWN;
+    }
+
+    good_windows = (per_valid && per_permille <= LINK_PHY_PER_OK_PERMILLE) ?
+                   MIN(good_windows + 1, UINT8_MAX) : 0;
+
+    LOG_DBG("Link quality: %s, RSSI %d dBm, PER %u permille (%u events)",
+            phy_name(cur_phy), rssi, per_permille, events);
+
+    /* A requested PHY that did not take is refused by the central */
+    if (requested_phy && requested_phy != cur_phy) {
+        LOG_INF("Central kept %s instead of %s", phy_name(cur_phy),
+                phy_name(requested_phy));
+        refused_phys |= PHY_MASK(requested_phy);
+    }
+    requested_phy = 0;
+
+    phy = choose_phy(per_valid);
+    request_phy(phy);
+
+    k_work_reschedule(&quality_work,
+                      K_MSEC(LINK_QUALITY_PERIOD_MS - LINK_QUALITY_WINDOW_MS));
+}
+
+int link_set_mode(link_mode_t new_mode)
+{
+    if (new_mode != LINK_MODE_IDLE && new_mode != LINK_MODE_ARMED) {
+        return -EINVAL;
+    }
+
+    if (!link_conn) {
+        return -ENOTCONN;
+    }
+
+    if (new_mode == LINK_MODE_IDLE) {
+        /* Keep the pending deadline if idle was already requested */
+        k_work_schedule(&idle_work, K_MSEC(LINK_IDLE_DELAY_MS));
+        return 0;
+    }
+
+    k_work_cancel_delayable(&idle_work);
+    if (mode_set && mode == LINK_MODE_ARMED) {
+        return 0;
+    }
+
+    mode = LINK_MODE_ARMED;
+    mode_set = true;
+    attempts = 0;
+    request_ms = k_uptime_get();
+    k_work_reschedule(&apply_work, K_NO_WAIT);
+    return 0;
+}
+
+void link_get_status(struct link_status *status)
+{
+    status->mode = mode;
+    status->applied = mode_set && params_match();
+    status->interval = cur_interval;
+    status->latency = cur_latency;
+    status->timeout = cur_timeout;
+    status->switch_ms = switch_ms;
+    status->phy = cur_phy;
+    status->rssi = rssi;
+    status->per_permille = per_permille;
+    status->phy_fallbacks = phy_fallbacks;
+}
+
+void link_get_radio(uint8_t *phy, int8_t *value)
+{
+    *phy = cur_phy;
+    *value = rssi;
+}
+
+bool link_anchors_valid(void)
+{
+    return link_conn && anchors_valid;
+}
+
+static void link_connected(struct bt_conn *conn, uint8_t err)
+{
+    struct bt_conn_info info;
+
+    if (err || link_conn || hub_is_buzzer_link(conn)) {
+        return;
+    }
+
+    link_conn = bt_conn_ref(conn);
+    mode_set = false;
+    request_ms = 0;
+
+    if (bt_conn_get_info(conn, &info) == 0) {
+        cur_interval = info.le.interval;
+        cur_latency = info.le.latency;
+        cur_timeout = info.le.timeout;
+        cur_phy = info.le.phy->tx_phy;
+    }
+    anchors_valid = (cur_latency == 0);
+
+    bt_hci_get_conn_handle(conn, &conn_handle);
+    requested_phy = 0;
+    refused_phys = 0;
+    good_windows = 0;
+    rssi = LINK_RSSI_UNKNOWN;
+    per_permille = 0;
+    phy_fallbacks = 0;
+    sampling = false;
+
+    request_phy(BT_GAP_LE_PHY_2M);
+    k_work_reschedule(&quality_work, K_MSEC(LINK_QUALITY_PERIOD_MS));
+}
+
+static void link_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+    if (conn != link_conn) {
+        return;
+    }
+
+    k_work_cancel_delayable(&apply_work);
+    k_work_cancel_delayable(&idle_work);
+    k_work_cancel_delayable(&phy_work);
+    k_work_cancel_delayable(&quality_work);
+    if (sampling) {
+        /* Reports stop with the connection; only the enable flag is left */
+        sampling = false;
+        k_work_submit(&qos_off_work);
+    }
+    bt_conn_unref(link_conn);
+    link_conn = NULL;
+    mode_set = false;
+}
+
+static void link_param_updated(struct bt_conn *conn, uint16_t interval,
+                               uint16_t latency, uint16_t timeout)
+{
+    if (conn != link_conn) {
+        return;
+    }
+
+    cur_interval = interval;
+    cur_latency = latency;
+    cur_timeout = timeout;
+
+    if (latency && anchors_valid) {
+        anchors_valid = false;
+        LOG_INF("Peripheral latency %u, connection event numbers dropped from press "
+                "events until latency is 0 again", latency);
+    } else if (!latency && !anchors_valid && timestamp_is_running()) {
+        /* Every event is taken part in from now on: count from here */
+        timestamp_restart_events();
+        anchors_valid = true;
+        LOG_INF("Connection event count restarted");
+    }
+
+    if (!mode_set) {
+        return;
+    }
+
+    if (params_match()) {
+        if (request_ms) {
+            switch_ms = MIN(k_uptime_get() - request_ms, UINT16_MAX);
+            request_ms = 0;
+            LOG_INF("Link mode %s applied in %u ms (interval %u, latency %u)",
+                    mode_name(mode), switch_ms, interval, latency);
+        }
+        return;
+    }
+
+    /* Moved away from the requested profile (central or automatic update) */
+    k_work_reschedule(&apply_work, K_MSEC(LINK_RETRY_MS));
+}
+
+static void link_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+    if (conn != link_conn) {
+        return;
+    }
+
+    if (param->tx_phy == requested_phy) {
+        requested_phy = 0;
+    }
+
+    if (param->tx_phy == cur_phy) {
+        return;
+    }
+
+    /* Each step down the list 2M, 1M, Coded is a fallback */
+    if (param->tx_phy == BT_GAP_LE_PHY_CODED ||
+        (param->tx_phy == BT_GAP_LE_PHY_1M && cur_phy == BT_GAP_LE_PHY_2M)) {
+        phy_fallbacks++;
+        LOG_WRN("PHY fallback %s -> %s (RSSI %d dBm, PER %u permille)",
+                phy_name(cur_phy), phy_name(param->tx_phy), rssi, per_permille);
+    } else {
+        LOG_INF("PHY %s (TX) / %s (RX)", phy_name(param->tx_phy),
+                phy_name(param->rx_phy));
+    }
+
+    cur_phy = param->tx_phy;
+    good_windows = 0;
+}
+
+BT_CONN_CB_DEFINE(link_conn_callbacks) = {
+    .connected = link_connected,
+    .disconnected = link_disconnected,
+    .le_param_updated = link_param_updated,
+    .le_phy_updated = link_phy_updated,
+};
+
+int link_init(void)
+{
+    k_work_init_delayable(&apply_work, apply_work_handler);
+    k_work_init_delayable(&idle_work, idle_work_handler);
+    k_work_init_delayable(&phy_work, phy_work_handler);
+    k_work_init_delayable(&quality_work, quality_work_handler);
+    k_work_init(&qos_off_work, qos_off_work_handler);
+
+    return bt_hci_register_vnd_evt_cb(qos_report_cb);
+}
@@ -0,0 +1,85 @@
+/**
+ * Link policy module
+ * 
+ * Switches the connection parameters between a low-latency "armed" profile
+ * while a question is open and a low-power "idle" profile in between,
+ * on request of the game client, and picks the PHY (2M when the link is
+ * good, 1M or Coded when it is marginal).
+ */
+
+#ifndef LINK_H
+#define LINK_H
+
+#include <zephyr/types.h>
+
+/**
+ * Connection parameter profiles
+ */
+typedef enum {
+    LINK_MODE_IDLE  = 0,  /* Long interval, peripheral latency */
+    LINK_MODE_ARMED = 1,  /* Shortest interval, no peripheral latency */
+} link_mode_t;
+
+/**
+ * Current link state, as reported by the Link Mode characteristic
+ */
+struct link_status {
+    uint8_t mode;             /* Requested link_mode_t */
+    uint8_t applied;          /* 1 once the connection runs with that profile */
+    uint16_t interval;        /* Connection interval (1.25 ms units) */
+    uint16_t latency;         /* Peripheral latency (connection events) */
+    uint16_t timeout;         /* Supervision timeout (10 ms units) */
+    uint16_t switch_ms;       /* Request-to-applied time of the last switch */
+    uint8_t phy;              /* Current TX PHY (BT_GAP_LE_PHY_*) */
+    int8_t rssi;              /* Last measured RSSI (dBm), LINK_RSSI_UNKNOWN if none */
+    uint16_t per_permille;    /* Packet error rate of the last quality window */
+    uint16_t phy_fallbacks;   /* Moves to a slower PHY on this connection */
+} __packed;
+
+/* RSSI value when none was measured yet (HCI convention) */
+#define LINK_RSSI_UNKNOWN  127
+
+/**
+ * Initialize the link policy
+ * 
+ * @return 0 on success, negative errno on failure
+ */
+int link_init(void);
+
+/**
+ * Request a link mode for the current connection
+ * Switching to armed is immediate, idle only after LINK_IDLE_DELAY_MS
+ * without another armed request.
+ * 
+ * @param mode LINK_MODE_ARMED or LINK_MODE_IDLE
+ * @return 0 on success, -EINVAL for an unknown mode, -ENOTCONN without a link
+ */
+int link_set_mode(link_mode_t mode);
+
+/**
+ * Get the requested mode and the parameters the link currently runs with
+ * 
+ * @param status Filled with the link state
+ */
+void link_get_status(struct link_status *status);
+
+/**
+ * Get the current PHY and the last measured RSSI, for press event records
+ * 
+ * @param phy Filled with the current TX PHY (BT_GAP_LE_PHY_*)
+ * @param rssi Filled with the RSSI in dBm, LINK_RSSI_UNKNOWN if none
+ */
+void link_get_radio(uint8_t *phy, int8_t *rssi);
+
+/**
+ * Check whether the connection event count of press timestamps matches the
+ * central's
+ * Not the case while the link runs with peripheral latency, because skipped
+ * events are not counted. The count restarts when latency is back to 0.
+ * 
+ * @return true while connected and no event was skipped since the count
+ *         (re)started
+ */
+bool link_anchors_valid(void);
+
+#endif /* LINK_H */
@@ -6,10 +6,14 @@
  */
 
 #include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/bluetooth/uuid.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/byteorder.h>
 #include <zephyr/device.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/pm/pm.h>
@@ -20,64 +24,130 @@
 #include "button.h"
 #include "led.h"
 #include "battery.h"
+#include "timestamp.h"
+#include "event_thread.h"
+#include "link.h"
+#include "identity.h"
+#include "advertising.h"
+#include "broadcast.h"
+#include "pawr.h"
+#include "hub.h"
+#include "receiver.h"
+#include "transport.h"
+
+LOG_MODULE_REGISTER(main, BUZZER_LOG_LEVEL);
 
 #define LED_FLASH_DURATION_MS    50   /* Short flash duration */
 #define LED_BLINK_DISCONNECTED_MS 2000  /* 2 seconds when disconnected (slower = less power) */
 #define LED_BLINK_CONNECTED_MS   5000  /* 5 seconds when connected (very slow) */
+#define LED_IDLE_LEVEL           64    /* Dimmer status blinks to save battery */
 
 /* Connection handle */
 static struct bt_conn *current_conn = NULL;
 
-/* Advertising data */
-static const struct bt_data ad[] = {
-    BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
-    BT_DATA_BYTES(BT_DATA_UUID128_ALL, BT_UUID_BUZZER_SERVICE_VAL),
+/* LED patterns, played by the LED sequencer without blocking the caller */
+static const struct led_pattern blink_disconnected = {
+    .step_count = 2,
+    .steps = {
+        { .level = LED_IDLE_LEVEL, .duration_ms = LED_FLASH_DURATION_MS },
+        { .level = 0, .duration_ms = LED_BLINK_DISCONNECTED_MS - LED_FLASH_DURATION_MS },
+    },
 };
 
-/* Status LED (onboard blue LED on P0.15) */
-static const struct gpio_dt_spec status_led = GPIO_DT_SPEC_GET(DT_ALIAS(led0), gpios);
-
-/* Buzzer LED (external white LED on P0.06) */
-static const struct gpio_dt_spec buzzer_led = GPIO_DT_SPEC_GET(DT_ALIAS(led1), gpios);
-
-/* Timer for LED blinking */
-static struct k_timer led_timer;
-static bool connection_status = false;
+static const struct led_pattern blink_connected = {
+    .step_count = 2,
+    .steps = {
+        { .level = LED_IDLE_LEVEL, .duration_ms = LED_FLASH_DURATION_MS },
+        { .level = 0, .duration_ms = LED_BLINK_CONNECTED_MS - LED_FLASH_DURATION_MS },
+    },
+};
 
-/* Work queue for LED flash (can't use k_sleep in timer handler) */
-static struct k_work led_flash_work;
+/* 5 quick blinks: startup (status LED) and successful connection (buzzer LED) */
+static const struct led_pattern blink_5x = {
+    .step_count = 2,
+    .repeat = 5,
+    .steps = {
+        { .level = 255, .duration_ms = 100 },
+        { .level = 0, .duration_ms = 100 },
+    },
+};
 
-/* Work queue for advertising restart (can't do BT ops in disconnect callback) */
-static struct k_work adv_restart_work;
+/* Buzzer LED test at startup */
+static const struct led_pattern buzzer_test = {
+    .step_count = 1,
+    .repeat = 1,
+    .steps = {
+        { .level = 255, .duration_ms = 500 },
+    },
+};
 
 /* Forward declarations */
 static void update_connection_status(bool connected);
-static int start_advertising(void);
+
+/* Press benchmark (PRESS_BENCH_PRESSES), started once after the first connection */
+static bool bench_started;
+
+static void bench_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    bench_started = true;
+    button_bench_start(PRESS_BENCH_PRESSES, PRESS_BENCH_RATE_HZ);
+}
+
+static K_WORK_DELAYABLE_DEFINE(bench_work, bench_work_handler);
+
+/* Track the connection interval that press anchor offsets refer to */
+static void update_conn_interval(struct bt_conn *conn)
+{
+    struct bt_conn_info info;
+
+    if (bt_conn_get_info(conn, &info) == 0) {
+        buzzer_service_set_conn_interval(info.le.interval);
+        timestamp_set_conn_interval(BT_CONN_INTERVAL_TO_US(info.le.interval));
+    }
+}
 
 /* Connection callbacks */
 static void connected(struct bt_conn *conn, uint8_t err)
 {
+    if (hub_is_buzzer_link(conn)) {
+        return;
+    }
+
+    if (err == BT_HCI_ERR_ADV_TIMEOUT) {
+        /* Directed advertising ended without a connection */
+        return;
+    }
     if (err) {
-        printk("Connection failed (err %u)\n", err);
+        LOG_ERR("Connection failed (err %u)", err);
         return;
     }
 
-    printk("Connected\n");
+    LOG_INF("Connected");
     current_conn = bt_conn_ref(conn);
     update_connection_status(true);
+
+    /* Press timestamps are only meaningful to a connected host */
+    timestamp_start();
+    update_conn_interval(conn);
+    timestamp_anchor_enable(conn);
     
     /* Blink buzzer LED 5 times quickly to indicate successful connection */
-    for (int i = 0; i < 5; i++) {
-        gpio_pin_set_dt(&buzzer_led, 1);
-        k_sleep(K_MSEC(100));
-        gpio_pin_set_dt(&buzzer_led, 0);
-        k_sleep(K_MSEC(100));
+    led_play(LED_BUZZER, &blink_5x);
+
+    if (PRESS_BENCH_PRESSES > 0 && !bench_started) {
+        k_work_schedule(&bench_work, K_MSEC(PRESS_BENCH_DELAY_MS));
     }
 }
 
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
-    printk("Disconnected (reason %u)\n", reason);
+    if (hub_is_buzzer_link(conn)) {
+        return;
+    }
+
+    LOG_INF("Disconnected (reason %u)", reason);
 
     if (current_conn) {
         bt_conn_unref(current_conn);
@@ -85,143 +155,145 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
     }
 
     update_connection_status(false);
+    if (!IS_ENABLED(CONFIG_BUZZER_BROADCAST) && !IS_ENABLED(CONFIG_BUZZER_PAWR) &&
+        !IS_ENABLED(CONFIG_BUZZER_HUB)) {
+        timestamp_stop();
+    }
+
+    /* Advertising restarts by itself (src/advertising.c) */
+}
+
+static void le_param_updated(struct bt_conn *conn, uint16_t interval,
+                             uint16_t latency, uint16_t timeout)
+{
+    if (hub_is_buzzer_link(conn)) {
+        return;
+    }
 
-    /* Schedule advertising restart - must be done outside BT callback context */
-    k_work_submit(&adv_restart_work);
+    LOG_INF("Connection parameters updated: interval %u, latency %u, timeout %u",
+            interval, latency, timeout);
+    buzzer_service_set_conn_interval(interval);
+    timestamp_set_conn_interval(BT_CONN_INTERVAL_TO_US(interval));
 }
 
 BT_CONN_CB_DEFINE(conn_callbacks) = {
     .connected = connected,
     .disconnected = disconnected,
+    .le_param_updated = le_param_updated,
 };
 
-/* Work handler for advertising restart */
-static void adv_restart_work_handler(struct k_work *work)
+#if defined(CONFIG_BUZZER_RECEIVER)
+/* Wired receiver command - game state from the PC, like a Game State write */
+static void receiver_command(uint8_t type, const uint8_t *data, uint8_t len)
 {
-    ARG_UNUSED(work);
-    int err;
+    uint8_t state;
 
-    printk("Restarting advertising from work queue...\n");
-
-    /* Small delay to let BT stack settle */
-    k_sleep(K_MSEC(100));
-    
-    err = start_advertising();
-    if (err && err != -EALREADY) {
-        printk("Failed to restart advertising (err %d)\n", err);
-    } else {
-        printk("Advertising restarted successfully\n");
+    if (type != RECEIVER_FRAME_GAME_STATE || len < 4 || data[0] > GAME_STATE_WINNER) {
+        return;
     }
-}
 
-/* Start advertising */
-static int start_advertising(void)
-{
-    struct bt_le_adv_param adv_param = {
-        .id = BT_ID_DEFAULT,
-        .options = BT_LE_ADV_OPT_CONN | BT_LE_ADV_OPT_USE_NAME,
-        .interval_min = ADV_INTERVAL_MIN,
-        .interval_max = ADV_INTERVAL_MAX,
-    };
-
-    int err = bt_le_adv_start(&adv_param, ad, ARRAY_SIZE(ad), NULL, 0);
-    if (err == -EALREADY) {
-        printk("Advertising already active\n");
-        return 0;
+    if (IS_ENABLED(CONFIG_BUZZER_HUB)) {
+        hub_set_game_state(data[0], sys_get_le16(&data[1]), data[3]);
+        return;
     }
-    if (err) {
-        printk("Advertising failed to start (err %d)\n", err);
-        return err;
+
+    /* The winner of a round gets WINNER, a buzzer that lost LOCKED */
+    state = data[0];
+    if (state == GAME_STATE_WINNER && data[3] != identity_get()->id) {
+        state = GAME_STATE_LOCKED;
     }
 
-    printk("Advertising started\n");
-    return 0;
+    buzzer_service_set_round(sys_get_le16(&data[1]));
+    buzzer_service_set_game_state(state);
 }
+#endif
 
-/* Button press callback */
-static void button_pressed_callback(bool pressed)
+/* Button press callback - runs on the event thread */
+static void button_pressed_callback(bool pressed, const struct press_timestamp *ts)
 {
-    printk("Button %s\n", pressed ? "PRESSED" : "RELEASED");
+    LOG_DBG("Button %s", pressed ? "PRESSED" : "RELEASED");
     
-    /* Flash buzzer LED on any button event for visual feedback */
-    if (pressed) {
-        gpio_pin_set_dt(&buzzer_led, 1);
-        printk("Buzzer LED ON\n");
+    /* With a game state from the host, only the first press of an open
+     * question is reported (and lights the LED until the host decides)
+     */
+    if (buzzer_service_game_state_active()) {
+        if (!buzzer_service_gate_button(pressed, ts)) {
+            return;
+        }
+    } else if (pressed) {
+        /* Light buzzer LED while the button is held for visual feedback */
+        led_set(LED_BUZZER, 255);
     } else {
-        gpio_pin_set_dt(&buzzer_led, 0);
-        printk("Buzzer LED OFF\n");
+        led_resume(LED_BUZZER);
     }
     
-    if (current_conn) {
-        printk("Sending button state to BLE client\n");
-        buzzer_service_send_button_state(pressed);
-    } else {
-        printk("No BLE connection - button event not sent\n");
-    }
-}
-
-/* LED flash work handler - runs in system workqueue context where k_sleep is allowed */
-static void led_flash_work_handler(struct k_work *work)
-{
-    ARG_UNUSED(work);
-    
-    /* Short flash ON for status LED
-     * Status LED is active-low hardware:
-     * gpio_pin_set(port, pin, 0) = pin LOW = LED ON
-     * gpio_pin_set(port, pin, 1) = pin HIGH = LED OFF
+    /* Every registered transport gets the change (GATT, broadcast, PAwR,
+     * wired receiver). GATT queues it even without a connection, delivered
+     * (with its age) on reconnect, unless a connectionless transport
+     * reaches the host already.
      */
-    gpio_pin_set(status_led.port, status_led.pin, 0);  /* ON (low) */
-    
-    /* Also flash buzzer LED when disconnected (active-high, so 1=ON) */
-    if (!connection_status) {
-        gpio_pin_set_dt(&buzzer_led, 1);  /* ON */
-    }
-    
-    k_sleep(K_MSEC(LED_FLASH_DURATION_MS));
-    
-    gpio_pin_set(status_led.port, status_led.pin, 1);  /* OFF (high) */
-    if (!connection_status) {
-        gpio_pin_set_dt(&buzzer_led, 0);  /* OFF */
-    }
-}
-
-/* LED timer handler - just schedules work, can't sleep in timer context */
-static void led_timer_handler(struct k_timer *timer)
-{
-    ARG_UNUSED(timer);
-    
-    /* Schedule the flash work - this runs in thread context where k_sleep is OK */
-    k_work_submit(&led_flash_work);
+    buzzer_service_send_button_state(pressed, ts);
 }
 
 static void update_connection_status(bool connected)
 {
-    connection_status = connected;
-    
-    /* Stop current timer and restart with appropriate interval */
-    k_timer_stop(&led_timer);
-    
     if (connected) {
-        /* Slow blink when connected (every 3 seconds) */
-        k_timer_start(&led_timer, K_MSEC(LED_BLINK_CONNECTED_MS), K_MSEC(LED_BLINK_CONNECTED_MS));
-        printk("Status LED: connected mode (3s interval)\n");
+        /* Slow status blink when connected, buzzer LED stays dark */
+        led_set_idle(LED_STATUS, &blink_connected);
+        led_set_idle(LED_BUZZER, NULL);
+        LOG_INF("Status LED: connected mode (%us interval)", LED_BLINK_CONNECTED_MS / 1000);
     } else {
-        /* Fast blink when disconnected (every 1 second) */
-        k_timer_start(&led_timer, K_MSEC(LED_BLINK_DISCONNECTED_MS), K_MSEC(LED_BLINK_DISCONNECTED_MS));
-        printk("Status LED: disconnected mode (1s interval)\n");
+        /* Faster blink when disconnected, buzzer LED flashes along */
+        led_set_idle(LED_STATUS, &blink_disconnected);
+        led_set_idle(LED_BUZZER, &blink_disconnected);
+        LOG_INF("Status LED: disconnected mode (%us interval)", LED_BLINK_DISCONNECTED_MS / 1000);
     }
 }
 
-/* Set Bluetooth device name based on buzzer ID - must be called AFTER bt_enable() */
+/* Set Bluetooth device name from the stored identity - must be called AFTER bt_enable() */
 static void set_bt_device_name(void)
 {
-    int err = bt_set_name(DEVICE_NAME);
+    const char *name = identity_get()->name;
+    int err = bt_set_name(name);
     if (err) {
-        printk("Failed to set Bluetooth device name: %d\n", err);
+        LOG_ERR("Failed to set Bluetooth device name: %d", err);
     } else {
-        printk("Bluetooth device name set to: %s\n", DEVICE_NAME);
+        LOG_INF("Bluetooth device name set to: %s", name);
         const char *current_name = bt_get_name();
-        printk("Current Bluetooth device name: %s\n", current_name);
+        LOG_INF("Current Bluetooth device name: %s", current_name);
+    }
+}
+
+/* Print edge-to-callback latency for both debounce modes when new presses were
+ * seen, and the callback-to-notify latency of the event queue
+ */
+static void report_button_latency(void)
+{
+    static uint32_t last_count[2];
+    struct button_latency_stats stats;
+    uint32_t notify_last_us, notify_max_us;
+    uint32_t wake_last_us, wake_max_us;
+    bool updated = false;
+
+    for (int mode = BUTTON_DEBOUNCE_TRAILING; mode <= BUTTON_DEBOUNCE_LEADING; mode++) {
+        button_get_latency_stats(mode, &stats);
+        if (stats.count == last_count[mode]) {
+            continue;
+        }
+        last_count[mode] = stats.count;
+        LOG_INF("Press latency (%s): last=%uus avg=%uus max=%uus n=%u",
+                mode == BUTTON_DEBOUNCE_LEADING ? "leading-edge" : "trailing-edge",
+                stats.last_us, stats.avg_us, stats.max_us, stats.count);
+        updated = true;
+    }
+
+    if (updated) {
+        buzzer_service_get_notify_latency(&notify_last_us, &notify_max_us);
+        LOG_INF("Queue-to-notify latency: last=%uus max=%uus", notify_last_us, notify_max_us);
+        event_thread_get_wake_latency(&wake_last_us, &wake_max_us);
+        LOG_INF("Event thread wake latency: last=%uus max=%uus", wake_last_us, wake_max_us);
+        buzzer_service_log_event_counts();
+        transport_log_stats();
     }
 }
 
@@ -230,69 +302,50 @@ int main(void)
 {
     int err;
 
-    printk("Starting Quiz Buzzer Firmware (Buzzer ID: %d)\n", BUZZER_ID);
+    /* Stored buzzer ID, name and colour (defaults if never provisioned) */
+    identity_init();
 
-    /* Initialize status LED first (onboard blue LED) - start OFF */
-    if (!device_is_ready(status_led.port)) {
-        printk("Status LED device not ready\n");
-        return -1;
-    }
-    gpio_pin_configure_dt(&status_led, GPIO_OUTPUT);  /* Configure as output */
-    gpio_pin_set(status_led.port, status_led.pin, 1);  /* Start OFF (high = LED off for active-low) */
-    printk("Status LED initialized on P0.15 (OFF)\n");
-
-    /* Initialize buzzer LED (external white LED) */
-    if (!device_is_ready(buzzer_led.port)) {
-        printk("Buzzer LED device not ready\n");
-        return -1;
-    }
-    gpio_pin_configure_dt(&buzzer_led, GPIO_OUTPUT_INACTIVE);
-    printk("Buzzer LED initialized on P0.06\n");
+    LOG_INF("Starting Quiz Buzzer Firmware (Buzzer ID: %d)", identity_get()->id);
 
-    /* Initialize LED module (for led_on/led_off functions) */
+    /* Initialize LEDs first (status and buzzer LED, both start OFF) */
     err = led_init();
     if (err) {
-        printk("LED init failed (err %d)\n", err);
+        LOG_ERR("LED init failed (err %d)", err);
         return err;
     }
 
-    /* Test buzzer LED at startup */
-    printk("Testing Buzzer LED...\n");
-    gpio_pin_set_dt(&buzzer_led, 1);
-    k_sleep(K_MSEC(500));
-    gpio_pin_set_dt(&buzzer_led, 0);
-    printk("Buzzer LED test complete\n");
-
-    /* Startup LED sequence - blink status LED 5 times to confirm flash worked */
-    printk("Startup LED sequence...\n");
-    for (int i = 0; i < 5; i++) {
-        gpio_pin_set(status_led.port, status_led.pin, 0);  /* ON (low) */
-        k_sleep(K_MSEC(100));
-        gpio_pin_set(status_led.port, status_led.pin, 1);  /* OFF (high) */
-        k_sleep(K_MSEC(100));
-    }
-    printk("Startup LED sequence complete\n");
+    /* Test buzzer LED and blink status LED 5 times to confirm flash worked.
+     * Both play in the background while initialization continues.
+     */
+    led_play(LED_BUZZER, &buzzer_test);
+    led_play(LED_STATUS, &blink_5x);
+
+    /* Button held at boot: pick a new buzzer ID before anything else starts */
+    identity_provision_local();
 
     /* Initialize button */
     err = button_init(button_pressed_callback);
     if (err) {
-        printk("Button init failed (err %d) - continuing without button\n", err);
+        LOG_WRN("Button init failed (err %d) - continuing without button", err);
     }
 
     /* Initialize battery monitoring */
     err = battery_init();
     if (err) {
-        printk("Battery init failed (err %d) - continuing without battery monitoring\n", err);
+        LOG_WRN("Battery init failed (err %d) - continuing without battery monitoring", err);
     }
 
     /* Enable Bluetooth */
     err = bt_enable(NULL);
     if (err) {
-        printk("Bluetooth init failed (err %d)\n", err);
+        LOG_ERR("Bluetooth init failed (err %d)", err);
         return err;
     }
 
-    printk("Bluetooth initialized\n");
+    LOG_INF("Bluetooth initialized");
+
+    /* Bonds and identity address stored by the host */
+    settings_load();
 
     /* Set Bluetooth device name - MUST be called AFTER bt_enable() */
     set_bt_device_name();
@@ -300,23 +353,70 @@ int main(void)
     /* Initialize buzzer service */
     err = buzzer_service_init();
     if (err) {
-        printk("Buzzer service init failed (err %d)\n", err);
+        LOG_ERR("Buzzer service init failed (err %d)", err);
         return err;
     }
 
-    /* Start advertising */
-    err = start_advertising();
+    /* Initialize link policy (armed / idle connection parameters) */
+    err = link_init();
     if (err) {
+        LOG_ERR("Link init failed (err %d)", err);
         return err;
     }
 
-    /* Initialize work queues and LED timer */
-    k_work_init(&led_flash_work, led_flash_work_handler);
-    k_work_init(&adv_restart_work, adv_restart_work_handler);
-    k_timer_init(&led_timer, led_timer_handler, NULL);
-    k_timer_start(&led_timer, K_MSEC(LED_BLINK_DISCONNECTED_MS), K_MSEC(LED_BLINK_DISCONNECTED_MS));
+#if defined(CONFIG_BUZZER_BROADCAST)
+    /* Second advertising set for press bursts */
+    err = broadcast_init();
+    if (err) {
+        LOG_ERR("Broadcast init failed (err %d)", err);
+        return err;
+    }
+#endif
+
+#if defined(CONFIG_BUZZER_PAWR)
+    /* Look for a hub's periodic advertising train */
+    err = pawr_init();
+    if (err) {
+        LOG_ERR("PAwR init failed (err %d)", err);
+        return err;
+    }
+#endif
+
+#if defined(CONFIG_BUZZER_RECEIVER)
+    /* Press events to the PC over USB as well */
+    err = receiver_init(receiver_command);
+    if (err) {
+        LOG_ERR("Receiver init failed (err %d)", err);
+        return err;
+    }
+#endif
+
+#if defined(CONFIG_BUZZER_HUB)
+    /* Collect the presses of other buzzers for the game client */
+    err = hub_init();
+    if (err) {
+        LOG_ERR("Hub init failed (err %d)", err);
+        return err;
+    }
+#endif
 
-    printk("Quiz Buzzer ready - advertising as: %s\n", bt_get_name());
+    /* Start advertising (directed toward the bonded central first) */
+    err = advertising_init();
+    if (err) {
+        LOG_ERR("Advertising init failed (err %d)", err);
+        return err;
+    }
+
+    err = advertising_start();
+    if (err) {
+        return err;
+    }
+
+    /* Initialize work queue and status blink */
+    update_connection_status(false);
+    advertising_set_ready(true);
+
+    LOG_INF("Quiz Buzzer ready - advertising as: %s", bt_get_name());
 
     /* Main loop - use longer sleep for power efficiency
      * The system will wake on:
@@ -332,6 +432,14 @@ int main(void)
         
         /* Update battery level periodically (rate-limited in battery_update) */
         battery_update();
+
+        /* Dim all LEDs on a low battery */
+        led_set_brightness_scale(battery_get_level() < LED_LOW_BATTERY_THRESHOLD ?
+                                 LED_BRIGHTNESS_LOW_BATTERY_PERCENT :
+                                 LED_BRIGHTNESS_DEFAULT_PERCENT);
+
+        /* Edge-to-callback latency, compare leading vs trailing debounce */
+        report_button_latency();
     }
 
     return 0;
@@ -0,0 +1,342 @@
+/**
+ * PAwR classroom mode implementation
+ * 
+ * The buzzer scans for the hub's extended advertising (manufacturer data
+ * with PAWR_BEACON_FRAME), synchronizes to its periodic advertising train
+ * and listens to its own subevent only. Requests are handled in the
+ * Bluetooth RX thread like a Game State write; the response for a pending
+ * press is set from there too, since it has to name the request event.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+
+#include "config.h"
+#include "pawr.h"
+#include "buzzer_service.h"
+#include "identity.h"
+#include "led.h"
+#include "transport.h"
+
+LOG_MODULE_REGISTER(pawr, BUZZER_LOG_LEVEL);
+
+static struct bt_le_per_adv_sync *hub_sync;
+static bool syncing;
+static uint8_t my_subevent;
+static uint8_t my_slot;
+
+/* Press waiting for an acknowledgement (event thread and RX thread) */
+static struct press_broadcast pending;
+static bool pending_valid;
+static uint32_t pending_edge_us;
+static bool pending_has_edge;
+
+/* Response sent in the last periodic event, acknowledged in the next one */
+static uint16_t sent_seq;
+static bool sent_valid;
+
+/* Last request applied, to act on changes only */
+static struct {
+    uint8_t phase;
+    uint16_t round_id;
+    uint8_t winner_id;
+    uint8_t cue;
+    uint8_t cue_id;
+    bool valid;
+} last;
+
+static const struct led_pattern identify_blink = {
+    .step_count = 2,
+    .repeat = 10,
+    .steps = {
+        { .level = 255, .duration_ms = 100 },
+        { .level = 0, .duration_ms = 100 },
+    },
+};
+
+static int start_scan(void)
+{
+    int err = bt_le_scan_start(BT_LE_SCAN_PASSIVE, NULL);
+
+    if (err && err != -EALREADY) {
+        LOG_ERR("Scanning failed to start (err %d)", err);
+        return err;
+    }
+
+    LOG_INF("Looking for a PAwR hub");
+    return 0;
+}
+
+static bool find_beacon(struct bt_data *data, void *user_data)
+{
+    bool *found = user_data;
+
+    if (data->type == BT_DATA_MANUFACTURER_DATA && data->data_len >= 3 &&
+        sys_get_le16(data->data) == ADV_MFR_COMPANY_ID &&
+        data->data[2] == PAWR_BEACON_FRAME) {
+        *found = true;
+        return false;
+    }
+
+    return true;
+}
+
+/* Scan callback - the hub's extended advertising points at the train */
+static void scan_recv(const struct bt_le_scan_recv_info *info, struct net_buf_simple *buf)
+{
+    struct bt_le_per_adv_sync_param param = {
+        .sid = info->sid,
+        .skip = 0,
+        .timeout = PAWR_SYNC_TIMEOUT,
+    };
+    bool found = false;
+    int err;
+
+    if (syncing || hub_sync || info->interval == 0) {
+        return;
+    }
+
+    bt_data_parse(buf, find_beacon, &found);
+    if (!found) {
+        return;
+    }
+
+    bt_addr_le_copy(&param.addr, info->addr);
+    err = bt_le_per_adv_sync_create(&param, &hub_sync);
+    if (err) {
+        LOG_WRN("Failed to create periodic sync (err %d)", err);
+        return;
+    }
+
+    syncing = true;
+}
+
+static struct bt_le_scan_cb scan_callbacks = {
+    .recv = scan_recv,
+};
+
+static void sync_synced(struct bt_le_per_adv_sync *s, struct bt_le_per_adv_sync_synced_info *info)
+{
+    struct bt_le_per_adv_sync_subevent_params params = {
+        .periodic_adv_properties = 0,
+        .num_subevents = 1,
+        .subevents = &my_subevent,
+    };
+    uint8_t index = identity_get()->id - 1;
+    int err;
+
+    syncing = false;
+    bt_le_scan_stop();
+
+    if (info->num_subevents == 0 || index >= info->num_subevents * info->num_response_slots) {
+        LOG_ERR("No response slot for buzzer ID %u (%u subevents x %u slots)",
+                identity_get()->id, info->num_subevents, info->num_response_slots);
+        bt_le_per_adv_sync_delete(s);
+        hub_sync = NULL;
+        return;
+    }
+
+    my_subevent = index % info->num_subevents;
+    my_slot = index / info->num_subevents;
+
+    err = bt_le_per_adv_sync_subevent(s, &params);
+    if (err) {
+        LOG_ERR("Failed to select subevent %u (err %d)", my_subevent, err);
+        return;
+    }
+
+    last.valid = false;
+    sent_valid = false;
+    LOG_INF("Synced to hub: interval %u, subevent %u of %u, slot %u of %u",
+            info->interval, my_subevent, info->num_subevents, my_slot,
+            info->num_response_slots);
+}
+
+static void sync_term(struct bt_le_per_adv_sync *s, const struct bt_le_per_adv_sync_term_info *info)
+{
+    LOG_WRN("Hub lost (reason %u)", info->reason);
+
+    hub_sync = NULL;
+    syncing = false;
+    buzzer_service_reset_game_state();
+    start_scan();
+}
+
+/* Apply the hub's game state, once per change */
+static void apply_request(const struct pawr_request *req)
+{
+    uint8_t id = identity_get()->id;
+    uint16_t round_id = sys_le16_to_cpu(req->round_id);
+
+    if (!last.valid || req->cue != last.cue || req->cue_id != last.cue_id) {
+        if (req->cue == PAWR_CUE_IDENTIFY && (req->cue_id == 0 || req->cue_id == id)) {
+            led_play(LED_BUZZER, &identify_blink);
+        }
+    }
+
+    if (!last.valid || req->phase != last.phase || round_id != last.round_id ||
+        req->winner_id != last.winner_id) {
+        buzzer_service_set_round(round_id);
+        switch (req->phase) {
+        case PAWR_PHASE_ARMED:
+            buzzer_service_set_game_state(GAME_STATE_ARMED);
+            break;
+        case PAWR_PHASE_CLOSED:
+            buzzer_service_set_game_state(req->winner_id == id ? GAME_STATE_WINNER :
+                                                                 GAME_STATE_LOCKED);
+            break;
+        default:
+            buzzer_service_set_game_state(GAME_STATE_IDLE);
+            break;
+        }
+    }
+
+    last.phase = req->phase;
+    last.round_id = round_id;
+    last.winner_id = req->winner_id;
+    last.cue = req->cue;
+    last.cue_id = req->cue_id;
+    last.valid = true;
+}
+
+/* Set the response for this request if a press is waiting */
+static void respond(const struct bt_le_per_adv_sync_recv_info *info, uint32_t ack_slots)
+{
+    struct bt_le_per_adv_response_params params = {
+        .request_event = info->periodic_event_counter,
+        .request_subevent = info->subevent,
+        .response_subevent = info->subevent,
+        .response_slot = my_slot,
+    };
+    NET_BUF_SIMPLE_DEFINE(rsp, 2 + sizeof(struct press_broadcast));
+    unsigned int key = irq_lock();
+    int err;
+
+    if (sent_valid && (ack_slots & BIT(my_slot)) && pending_valid &&
+        sys_le16_to_cpu(pending.record.seq) == sent_seq) {
+        pending_valid = false;
+    }
+    sent_valid = false;
+
+    if (!pending_valid) {
+        irq_unlock(key);
+        return;
+    }
+
+    if (pending_has_edge) {
+        pending.record.age_ms = sys_cpu_to_le16((timestamp_now() - pending_edge_us) / 1000);
+    }
+    net_buf_simple_add_u8(&rsp, 1 + sizeof(pending));
+    net_buf_simple_add_u8(&rsp, BT_DATA_MANUFACTURER_DATA);
+    net_buf_simple_add_mem(&rsp, &pending, sizeof(pending));
+    sent_seq = sys_le16_to_cpu(pending.record.seq);
+    irq_unlock(key);
+
+    err = bt_le_per_adv_set_response_data(hub_sync, &params, &rsp);
+    if (err) {
+        LOG_WRN("Failed to set response (err %d)", err);
+        return;
+    }
+
+    sent_valid = true;
+}
+
+static bool find_request(struct bt_data *data, void *user_data)
+{
+    struct pawr_request *req = user_data;
+
+    if (data->type == BT_DATA_MANUFACTURER_DATA && data->data_len >= sizeof(*req) &&
+        sys_get_le16(data->data) == ADV_MFR_COMPANY_ID &&
+        data->data[2] == PAWR_REQUEST_FRAME) {
+        memcpy(req, data->data, sizeof(*req));
+        return false;
+    }
+
+    return true;
+}
+
+/* Periodic advertising receive callback - a request in our subevent */
+static void sync_recv(struct bt_le_per_adv_sync *s, const struct bt_le_per_adv_sync_recv_info *info,
+                      struct net_buf_simple *buf)
+{
+    struct pawr_request req = { 0 };
+
+    if (!buf || buf->len == 0 || info->subevent != my_subevent) {
+        return;
+    }
+
+    bt_data_parse(buf, find_request, &req);
+    if (req.frame != PAWR_REQUEST_FRAME) {
+        return;
+    }
+
+    apply_request(&req);
+    respond(info, sys_le32_to_cpu(req.ack_slots));
+}
+
+static struct bt_le_per_adv_sync_cb sync_callbacks = {
+    .synced = sync_synced,
+    .term = sync_term,
+    .recv = sync_recv,
+};
+
+/* PAwR transport: the newest press waits for the next response slot,
+ * replacing one that was not acknowledged yet
+ */
+static size_t pawr_send(const struct transport_event *events, size_t count)
+{
+    const struct transport_event *event = &events[count - 1];
+
+    unsigned int key = irq_lock();
+
+    pending.company_id = sys_cpu_to_le16(ADV_MFR_COMPANY_ID);
+    pending.frame = PAWR_RESPONSE_FRAME;
+    pending.buzzer_id = event->buzzer_id;
+    pending.record = event->record;
+    pending_has_edge = (event->record.flags & PRESS_EVENT_FLAG_TIMESTAMP) &&
+                       timestamp_is_running();
+    pending_edge_us = sys_le32_to_cpu(event->record.edge_us);
+    pending_valid = true;
+    irq_unlock(key);
+
+    LOG_DBG("Press seq %u waiting for slot %u", sys_le16_to_cpu(event->record.seq), my_slot);
+    return count;
+}
+
+static struct transport_event pawr_queue[TRANSPORT_QUEUE_LEN];
+
+static struct transport pawr_transport = {
+    .name = "pawr",
+    .send = pawr_send,
+    .is_active = pawr_is_synced,
+    .batch_max = 1,
+    .flags = TRANSPORT_FLAG_PRESSES_ONLY | TRANSPORT_FLAG_CONNECTIONLESS,
+    .queue = pawr_queue,
+    .queue_len = ARRAY_SIZE(pawr_queue),
+};
+
+int pawr_init(void)
+{
+    int err;
+
+    err = transport_register(&pawr_transport);
+    if (err) {
+        return err;
+    }
+
+    /* Edge timestamps and reaction times without a connection */
+    timestamp_start();
+
+    bt_le_scan_cb_register(&scan_callbacks);
+    bt_le_per_adv_sync_cb_register(&sync_callbacks);
+
+    return start_scan();
+}
+
+bool pawr_is_synced(void)
+{
+    return hub_sync && !syncing;
+}
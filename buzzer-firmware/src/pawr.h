@@ -0,0 +1,75 @@
+/**
+ * PAwR classroom mode (CONFIG_BUZZER_PAWR)
+ * 
+ * A hub drives many buzzers over Periodic Advertising with Responses: in
+ * every periodic event it sends one request per subevent with the game
+ * state, and each buzzer answers a press in its own response slot. Buzzer
+ * ID n (1-based) uses subevent (n - 1) % num_subevents and response slot
+ * (n - 1) / num_subevents, so responses never collide and the press
+ * latency is bounded by one periodic interval plus the slot offset.
+ * 
+ * The game state, press gating, LEDs and press records are those of the
+ * GATT service (buzzer_service.c); only the transport differs.
+ */
+
+#ifndef PAWR_H
+#define PAWR_H
+
+#include <zephyr/types.h>
+#include <zephyr/toolchain.h>
+
+#include "timestamp.h"
+#include "press_event.h"
+
+/* Frame byte of the hub's extended advertising, so buzzers find the train */
+#define PAWR_BEACON_FRAME    0x82
+
+/* Frame byte of a subevent request */
+#define PAWR_REQUEST_FRAME   0x83
+
+/* Frame byte of a buzzer response (struct press_broadcast with this frame) */
+#define PAWR_RESPONSE_FRAME  0x84
+
+/* Request phases */
+#define PAWR_PHASE_IDLE    0   /* No question open */
+#define PAWR_PHASE_ARMED   1   /* Question open */
+#define PAWR_PHASE_CLOSED  2   /* Decided, winner_id won (0 = nobody) */
+
+/* LED cues */
+#define PAWR_CUE_NONE      0
+#define PAWR_CUE_IDENTIFY  1   /* Blink the buzzer LED of cue_id (0 = all) */
+
+/**
+ * Subevent request, sent by the hub as manufacturer specific data
+ * ack_slots acknowledges the responses the hub received in this subevent
+ * during the previous periodic event (bit n = slot n); a buzzer repeats its
+ * press response until it is acknowledged.
+ */
+struct pawr_request {
+    uint16_t company_id;        /* ADV_MFR_COMPANY_ID */
+    uint8_t  frame;             /* PAWR_REQUEST_FRAME */
+    uint8_t  phase;             /* PAWR_PHASE_* */
+    uint16_t round_id;          /* Round of the current question */
+    uint8_t  winner_id;         /* Buzzer ID that won the round (PHASE_CLOSED) */
+    uint8_t  cue;               /* PAWR_CUE_* */
+    uint8_t  cue_id;            /* Buzzer ID the cue is for (0 = all) */
+    uint32_t ack_slots;         /* Acknowledged response slots */
+} __packed;
+
+/**
+ * Register the PAwR transport and start looking for the hub's periodic
+ * advertising train
+ * While synced, presses go out in the buzzer's response slot through
+ * transport.h; a newer press replaces an unacknowledged one.
+ * Call after bt_enable().
+ * 
+ * @return 0 on success, negative errno on failure
+ */
+int pawr_init(void);
+
+/**
+ * Check whether the buzzer is synchronized to a hub
+ */
+bool pawr_is_synced(void);
+
+#endif /* PAWR_H */
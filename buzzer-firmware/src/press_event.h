@@ -0,0 +1,78 @@
+/**
+ * Press event record shared by every path that reports button events
+ * 
+ * Packed little-endian wire format. Receivers must check the version byte and
+ * ignore trailing bytes they do not understand, so fields can be appended
+ * without bumping the version.
+ */
+
+#ifndef PRESS_EVENT_H
+#define PRESS_EVENT_H
+
+#include <zephyr/types.h>
+#include <zephyr/toolchain.h>
+
+/* Record format version */
+#define PRESS_EVENT_VERSION  1
+
+/* Event types */
+#define PRESS_EVENT_TYPE_RELEASE  0
+#define PRESS_EVENT_TYPE_PRESS    1
+
+/* Button index of the main buzzer button */
+#define PRESS_EVENT_BUTTON_MAIN  0
+
+/* Flags */
+#define PRESS_EVENT_FLAG_TIMESTAMP  BIT(0)  /* edge_us and anchor fields are valid */
+#define PRESS_EVENT_FLAG_REPLAY     BIT(1)  /* Re-sent on host request */
+#define PRESS_EVENT_FLAG_REACTION   BIT(2)  /* reaction_us is valid */
+
+/* Round ID of events queued before the host sent one */
+#define PRESS_EVENT_ROUND_NONE  0
+
+/**
+ * Press event record
+ * The first 20 bytes fit a default 23-byte ATT MTU notification; with a
+ * default MTU the trailing fields are cut off and the receiver must treat
+ * them as absent.
+ */
+struct press_event_record {
+    uint8_t  version;           /* PRESS_EVENT_VERSION */
+    uint8_t  type;              /* PRESS_EVENT_TYPE_* */
+    uint16_t seq;               /* Sequence number, +1 per event, wraps */
+    uint8_t  button;            /* Button index */
+    uint8_t  flags;             /* PRESS_EVENT_FLAG_* */
+    uint32_t edge_us;           /* Hardware edge time (us, free-running) */
+    uint32_t conn_event;        /* Connection events started before the edge */
+    uint32_t anchor_offset_us;  /* Offset from that event's anchor point (us) */
+    uint16_t conn_interval;     /* Connection interval (1.25 ms units) */
+    uint16_t age_ms;            /* Time the event spent queued on the buzzer (saturates) */
+    uint8_t  phy;               /* TX PHY at queue time (BT_GAP_LE_PHY_*) */
+    int8_t   rssi;              /* Last measured RSSI (dBm), 127 = unknown */
+    uint32_t reaction_us;       /* Arm command received to press edge (us) */
+    uint16_t round_id;          /* Round current at the edge (as written by the host) */
+} __packed;
+
+/* Frame byte of a press broadcast. The advertised manufacturer data of the
+ * connectable advertising uses values below 0x80 there (its version).
+ */
+#define PRESS_BROADCAST_FRAME  0x81
+
+/**
+ * Press broadcast (CONFIG_BUZZER_BROADCAST), sent as manufacturer specific
+ * data in non-connectable extended advertising. Every copy of a burst
+ * carries the same data; receivers drop duplicates by buzzer ID and seq.
+ */
+struct press_broadcast {
+    uint16_t company_id;        /* ADV_MFR_COMPANY_ID */
+    uint8_t  frame;             /* PRESS_BROADCAST_FRAME */
+    uint8_t  buzzer_id;         /* Provisioned ID (1-255) */
+    struct press_event_record record;  /* Connection event and anchor are 0 */
+} __packed;
+
+/* Replay request written by the host to the Button Event characteristic:
+ * opcode (1 byte) + first missing sequence number (2 bytes, little-endian)
+ */
+#define PRESS_EVENT_OP_REPLAY  0x01
+
+#endif /* PRESS_EVENT_H */
@@ -0,0 +1,303 @@
+/**
+ * Wired receiver implementation
+ * 
+ * Frames go out with uart_poll_out() on the receiver UART (CDC-ACM on the
+ * board, a pty on native_sim) and, with CONFIG_USB_DEVICE_HID, as an input
+ * report on the HID interrupt endpoint (1 ms poll interval). Host commands
+ * are polled from the UART every RECEIVER_POLL_MS and arrive on HID as
+ * output reports.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <string.h>
+
+#if defined(CONFIG_USB_DEVICE_STACK)
+#include <zephyr/usb/usb_device.h>
+#endif
+#if defined(CONFIG_USB_DEVICE_HID)
+#include <zephyr/usb/class/usb_hid.h>
+#endif
+
+#include "config.h"
+#include "receiver.h"
+#include "transport.h"
+
+LOG_MODULE_REGISTER(receiver, BUZZER_LOG_LEVEL);
+
+static const struct device *const uart_dev = DEVICE_DT_GET(DT_CHOSEN(buzzer_receiver_uart));
+
+static receiver_command_cb_t command_cb;
+
+/* Serializes frames written from the event thread, the Bluetooth RX thread
+ * and the workqueue
+ */
+static K_MUTEX_DEFINE(tx_lock);
+
+/* A pty is always there; USB only once the host configured the device */
+static bool host_attached = !IS_ENABLED(CONFIG_USB_DEVICE_STACK);
+
+static uint32_t tx_frames;
+static uint32_t tx_dropped;
+
+/* Command parser: sync, length, type, payload, CRC */
+static uint8_t rx_frame[2 + RECEIVER_MAX_PAYLOAD + 1];
+static uint8_t rx_pos;
+static struct k_work_delayable poll_work;
+
+#if defined(CONFIG_USB_DEVICE_HID)
+static const struct device *hid_dev;
+
+/* Vendor-defined reports, one frame each way */
+static const uint8_t hid_report_desc[] = {
+    0x06, 0x00, 0xFF,                   /* Usage Page (Vendor Defined 0xFF00) */
+    HID_USAGE(0x01),
+    HID_COLLECTION(HID_COLLECTION_APPLICATION),
+        HID_LOGICAL_MIN8(0x00),
+        HID_LOGICAL_MAX16(0xFF, 0x00),
+        HID_REPORT_SIZE(8),
+        HID_REPORT_COUNT(RECEIVER_HID_REPORT_SIZE),
+        HID_USAGE(0x02),
+        HID_INPUT(0x02),                /* Data, Var, Abs */
+        HID_REPORT_COUNT(RECEIVER_HID_REPORT_SIZE),
+        HID_USAGE(0x03),
+        HID_OUTPUT(0x02),
+    HID_END_COLLECTION,
+};
+
+/* Output report from the host, handed to the workqueue */
+static uint8_t hid_command[RECEIVER_HID_REPORT_SIZE];
+static struct k_work hid_command_work;
+#endif
+
+static void handle_frame(uint8_t type, const uint8_t *data, uint8_t len)
+{
+    if (type == RECEIVER_FRAME_PING) {
+        uint8_t pong[8];
+
+        if (len < 4) {
+            return;
+        }
+        memcpy(pong, data, 4);
+        sys_put_le32(k_cyc_to_us_floor32(k_cycle_get_32()), &pong[4]);
+        receiver_send(RECEIVER_FRAME_PONG, pong, sizeof(pong));
+        return;
+    }
+
+    if (command_cb) {
+        command_cb(type, data, len);
+    }
+}
+
+static void parse_byte(uint8_t c)
+{
+    if (rx_pos == 0) {
+        if (c == RECEIVER_SYNC) {
+            rx_frame[rx_pos++] = c;
+        }
+        return;
+    }
+
+    if (rx_pos == 1 && c > RECEIVER_MAX_PAYLOAD) {
+        /* Not a length, look for the next sync byte */
+        rx_pos = 0;
+        return;
+    }
+
+    rx_frame[rx_pos++] = c;
+
+    /* Sync, length, type, payload, CRC */
+    if (rx_pos < 4 || rx_pos < rx_frame[1] + 4) {
+        return;
+    }
+
+    rx_pos = 0;
+    if (crc8_ccitt(0, &rx_frame[1], rx_frame[1] + 2) != rx_frame[rx_frame[1] + 3]) {
+        LOG_WRN("Host frame with bad CRC dropped");
+        return;
+    }
+
+    handle_frame(rx_frame[2], &rx_frame[3], rx_frame[1]);
+}
+
+/* Poll work handler - read whatever the host sent since the last poll */
+static void poll_work_handler(struct k_work *work)
+{
+    unsigned char c;
+
+    ARG_UNUSED(work);
+
+    while (uart_poll_in(uart_dev, &c) == 0) {
+        parse_byte(c);
+    }
+
+    k_work_schedule(&poll_work, K_MSEC(RECEIVER_POLL_MS));
+}
+
+#if defined(CONFIG_USB_DEVICE_HID)
+static void hid_command_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    if (hid_command[0] <= RECEIVER_MAX_PAYLOAD) {
+        handle_frame(hid_command[1], &hid_command[2], hid_command[0]);
+    }
+}
+
+/* SET_REPORT on the control endpoint (hosts without an OUT endpoint) */
+static int hid_set_report(const struct device *dev, struct usb_setup_packet *setup,
+                          int32_t *len, uint8_t **data)
+{
+    memset(hid_command, 0, sizeof(hid_command));
+    memcpy(hid_command, *data, MIN(*len, sizeof(hid_command)));
+    k_work_submit(&hid_command_work);
+    return 0;
+}
+
+static const struct hid_ops hid_callbacks = {
+    .set_report = hid_set_report,
+};
+#endif
+
+#if defined(CONFIG_USB_DEVICE_STACK)
+static void usb_status(enum usb_dc_status_code status, const uint8_t *param)
+{
+    switch (status) {
+    case USB_DC_CONFIGURED:
+        if (!host_attached) {
+            LOG_INF("USB host attached");
+        }
+        host_attached = true;
+        break;
+    case USB_DC_DISCONNECTED:
+    case USB_DC_SUSPEND:
+    case USB_DC_RESET:
+        host_attached = false;
+        break;
+    default:
+        break;
+    }
+}
+#endif
+
+void receiver_send(uint8_t type, const void *data, uint8_t len)
+{
+    uint8_t frame[3 + RECEIVER_MAX_PAYLOAD + 1];
+
+    if (len > RECEIVER_MAX_PAYLOAD) {
+        return;
+    }
+
+    if (!host_attached) {
+        tx_dropped++;
+        return;
+    }
+
+    frame[0] = RECEIVER_SYNC;
+    frame[1] = len;
+    frame[2] = type;
+    memcpy(&frame[3], data, len);
+    frame[3 + len] = crc8_ccitt(0, &frame[1], len + 2);
+
+    k_mutex_lock(&tx_lock, K_FOREVER);
+
+    for (int i = 0; i < len + 4; i++) {
+        uart_poll_out(uart_dev, frame[i]);
+    }
+
+#if defined(CONFIG_USB_DEVICE_HID)
+    uint8_t report[RECEIVER_HID_REPORT_SIZE] = { 0 };
+
+    memcpy(report, &frame[1], len + 2);
+    if (hid_int_ep_write(hid_dev, report, sizeof(report), NULL)) {
+        /* Previous report not collected yet (within one poll interval) */
+        tx_dropped++;
+    }
+#endif
+
+    tx_frames++;
+    k_mutex_unlock(&tx_lock);
+}
+
+/* Receiver transport: every event as its own frame */
+static size_t receiver_transport_send(const struct transport_event *events, size_t count)
+{
+    uint8_t payload[1 + sizeof(events[0].record)];
+
+    for (size_t i = 0; i < count; i++) {
+        payload[0] = events[i].buzzer_id;
+        memcpy(&payload[1], &events[i].record, sizeof(events[i].record));
+        receiver_send(RECEIVER_FRAME_EVENT, payload, sizeof(payload));
+    }
+
+    LOG_DBG("%zu event(s) sent to host (%u frames, %u dropped)", count, tx_frames, tx_dropped);
+    return count;
+}
+
+static bool receiver_is_active(void)
+{
+    return host_attached;
+}
+
+static struct transport_event receiver_queue[TRANSPORT_QUEUE_LEN];
+
+static struct transport receiver_transport = {
+    .name = "receiver",
+    .send = receiver_transport_send,
+    .is_active = receiver_is_active,
+    .batch_max = TRANSPORT_QUEUE_LEN,
+    .queue = receiver_queue,
+    .queue_len = ARRAY_SIZE(receiver_queue),
+};
+
+int receiver_init(receiver_command_cb_t cb)
+{
+    int err = 0;
+
+    if (!device_is_ready(uart_dev)) {
+        LOG_ERR("Receiver UART not ready");
+        return -ENODEV;
+    }
+
+    command_cb = cb;
+
+    err = transport_register(&receiver_transport);
+    if (err) {
+        return err;
+    }
+
+#if defined(CONFIG_USB_DEVICE_HID)
+    hid_dev = device_get_binding("HID_0");
+    if (!hid_dev) {
+        LOG_ERR("HID device not found");
+        return -ENODEV;
+    }
+
+    k_work_init(&hid_command_work, hid_command_work_handler);
+    usb_hid_register_device(hid_dev, hid_report_desc, sizeof(hid_report_desc),
+                            &hid_callbacks);
+    err = usb_hid_init(hid_dev);
+    if (err) {
+        LOG_ERR("HID init failed (err %d)", err);
+        return err;
+    }
+#endif
+
+#if defined(CONFIG_USB_DEVICE_STACK)
+    err = usb_enable(usb_status);
+    if (err) {
+        LOG_ERR("USB enable failed (err %d)", err);
+        return err;
+    }
+#endif
+
+    k_work_init_delayable(&poll_work, poll_work_handler);
+    k_work_schedule(&poll_work, K_MSEC(RECEIVER_POLL_MS));
+
+    LOG_INF("Wired receiver ready on %s", uart_dev->name);
+    return err;
+}
@@ -0,0 +1,69 @@
+/**
+ * Wired receiver module (CONFIG_BUZZER_RECEIVER)
+ * 
+ * Forwards press events to the PC over USB, next to the Bluetooth link, so
+ * a host that reads the serial port or the HID device is not subject to
+ * the browser's Bluetooth latency. The events are those of the local
+ * button and, in the hub variant, of the relayed buzzers, in the same
+ * records as on the GATT path.
+ * 
+ * Both directions use the same framing on CDC-ACM (and on the native_sim
+ * pty): RECEIVER_SYNC, payload length (1), frame type (1), payload, CRC-8
+ * (CCITT, initial value 0, over length, type and payload). On HID every
+ * report holds one frame without sync byte and CRC, padded to
+ * RECEIVER_HID_REPORT_SIZE.
+ */
+
+#ifndef RECEIVER_H
+#define RECEIVER_H
+
+#include <zephyr/types.h>
+
+#include "config.h"
+#include "press_event.h"
+
+/* Frames to the host */
+#define RECEIVER_FRAME_EVENT      0x01  /* Buzzer ID (1), struct press_event_record */
+#define RECEIVER_FRAME_HUB_EVENT  0x02  /* struct hub_event (hub variant) */
+#define RECEIVER_FRAME_PONG       0x03  /* Token (4), receiver time (4, us) */
+
+/* Frames from the host */
+#define RECEIVER_FRAME_GAME_STATE 0x81  /* State (1), round ID (2), winner ID (1) */
+#define RECEIVER_FRAME_PING       0x82  /* Token (4), answered with a pong */
+#define RECEIVER_FRAME_PRESS      0x83  /* Buzzer ID (1), count (1, optional); native_sim only */
+
+/* HID input and output report size: length, type and the largest payload */
+#define RECEIVER_HID_REPORT_SIZE  (2 + RECEIVER_MAX_PAYLOAD)
+
+/**
+ * Host command callback, called on the system workqueue
+ * 
+ * @param type RECEIVER_FRAME_GAME_STATE or RECEIVER_FRAME_PRESS (pings are
+ *             answered by the module)
+ * @param data Payload
+ * @param len Payload length
+ */
+typedef void (*receiver_command_cb_t)(uint8_t type, const uint8_t *data, uint8_t len);
+
+/**
+ * Enable USB, register the receiver transport and start polling for host
+ * commands
+ * Press events then reach the host through transport.h, as
+ * RECEIVER_FRAME_EVENT frames.
+ * 
+ * @param cb Host command callback
+ * @return 0 on success, negative errno on failure
+ */
+int receiver_init(receiver_command_cb_t cb);
+
+/**
+ * Send a frame to the host
+ * Safe from any thread; dropped while no host is attached.
+ * 
+ * @param type RECEIVER_FRAME_*
+ * @param data Payload
+ * @param len Payload length, at most RECEIVER_MAX_PAYLOAD
+ */
+void receiver_send(uint8_t type, const void *data, uint8_t len);
+
+#endif /* RECEIVER_H */
@@ -0,0 +1,88 @@
+/**
+ * Wired receiver on native_sim
+ * 
+ * Runs the receiver protocol (src/receiver.c) on a pty instead of USB, so
+ * host tools can be tested on Linux without a board. There is no button or
+ * radio: a RECEIVER_FRAME_PRESS command makes up presses of the given
+ * buzzer ID, sent back through the transport layer as RECEIVER_FRAME_EVENT
+ * frames like real ones. A burst of them is for timing the pty path from
+ * the host (the simulated clock does not advance while code runs); the
+ * transport statistics are logged after it.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "config.h"
+#include "receiver.h"
+#include "press_event.h"
+#include "transport.h"
+
+LOG_MODULE_REGISTER(receiver_sim, BUZZER_LOG_LEVEL);
+
+static uint16_t round_id = PRESS_EVENT_ROUND_NONE;
+static uint16_t next_seq;
+
+/* Made-up presses through the transport layer, count (1-255) back to back */
+static void sim_presses(uint8_t buzzer_id, uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++) {
+        struct transport_event event = {
+            .record = {
+                .version = PRESS_EVENT_VERSION,
+                .type = PRESS_EVENT_TYPE_PRESS,
+                .seq = sys_cpu_to_le16(next_seq++),
+                .button = PRESS_EVENT_BUTTON_MAIN,
+                .flags = PRESS_EVENT_FLAG_TIMESTAMP,
+                .edge_us = sys_cpu_to_le32(k_cyc_to_us_floor32(k_cycle_get_32())),
+                .rssi = INT8_MAX,
+                .round_id = sys_cpu_to_le16(round_id),
+            },
+            .buzzer_id = buzzer_id,
+            .uptime_ms = k_uptime_get(),
+            .queued_cycles = k_cycle_get_32(),
+        };
+
+        transport_submit(&event);
+    }
+
+    if (count > 1) {
+        transport_log_stats();
+    }
+}
+
+static void sim_command(uint8_t type, const uint8_t *data, uint8_t len)
+{
+    switch (type) {
+    case RECEIVER_FRAME_GAME_STATE:
+        if (len >= 3) {
+            round_id = sys_get_le16(&data[1]);
+        }
+        break;
+    case RECEIVER_FRAME_PRESS:
+        if (len >= 1) {
+            sim_presses(data[0], len >= 2 ? MAX(data[1], 1) : 1);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+int main(void)
+{
+    int err;
+
+    err = receiver_init(sim_command);
+    if (err) {
+        LOG_ERR("Receiver init failed (err %d)", err);
+        return err;
+    }
+
+    while (1) {
+        k_sleep(K_FOREVER);
+    }
+
+    return 0;
+}
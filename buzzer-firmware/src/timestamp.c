@@ -0,0 +1,222 @@
+/**
+ * Hardware press timestamping implementation
+ * 
+ * GPIOTE IN[n] (button edge) --PPI--> TIMER CAPTURE[0]
+ *                                 +-> COUNTER CAPTURE[0]
+ * Controller event start --> EGU TRIGGER[0] --PPI--> TIMER CAPTURE[2]
+ *                                                +-> COUNTER COUNT
+ * 
+ * The GPIOTE channel is the one the Zephyr GPIO driver allocated for the
+ * button interrupt, so the same edge both wakes the CPU and latches the time.
+ * The SoftDevice Controller "set event start task" vendor command triggers
+ * the EGU task at the start of every connection event (the anchor point).
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/drivers/clock_control.h>
+#include <zephyr/drivers/clock_control/nrf_clock_control.h>
+#include <zephyr/sys/byteorder.h>
+#include <nrfx_gpiote.h>
+#include <nrfx_timer.h>
+#include <hal/nrf_egu.h>
+#include <helpers/nrfx_gppi.h>
+#include <sdc_hci_vs.h>
+
+#include "config.h"
+#include "timestamp.h"
+
+LOG_MODULE_REGISTER(timestamp, BUZZER_LOG_LEVEL);
+
+#define CC_EDGE    NRF_TIMER_CC_CHANNEL0  /* Latched by the button edge via PPI */
+#define CC_NOW     NRF_TIMER_CC_CHANNEL1  /* Software capture */
+#define CC_ANCHOR  NRF_TIMER_CC_CHANNEL2  /* Latched at each connection event start */
+
+#define CC_EVENTS_AT_EDGE  NRF_TIMER_CC_CHANNEL0  /* Counter value latched by the edge */
+#define CC_EVENTS_NOW      NRF_TIMER_CC_CHANNEL1  /* Software capture */
+
+#define ANCHOR_EGU NRFX_CONCAT_2(NRF_EGU, TIMESTAMP_EGU_INSTANCE)
+
+static const nrfx_timer_t timer = NRFX_TIMER_INSTANCE(TIMESTAMP_TIMER_INSTANCE);
+static const nrfx_timer_t counter = NRFX_TIMER_INSTANCE(TIMESTAMP_COUNTER_INSTANCE);
+static const nrfx_gpiote_t gpiote = NRFX_GPIOTE_INSTANCE(0);
+
+static struct onoff_client hfclk_cli;
+static bool initialized = false;
+static bool running = false;
+static uint32_t conn_interval_us;
+
+/* Timers run free with no compare interrupts, but nrfx requires a handler */
+static void timer_event_handler(nrf_timer_event_t event_type, void *context)
+{
+    ARG_UNUSED(event_type);
+    ARG_UNUSED(context);
+}
+
+int timestamp_init(uint32_t pin)
+{
+    nrfx_timer_config_t timer_cfg = NRFX_TIMER_DEFAULT_CONFIG(MHZ(1));
+    nrfx_timer_config_t counter_cfg = NRFX_TIMER_DEFAULT_CONFIG(MHZ(1));
+    uint8_t edge_ch;
+    uint8_t anchor_ch;
+    uint8_t gpiote_ch;
+
+    timer_cfg.bit_width = NRF_TIMER_BIT_WIDTH_32;
+    counter_cfg.bit_width = NRF_TIMER_BIT_WIDTH_32;
+    counter_cfg.mode = NRF_TIMER_MODE_LOW_POWER_COUNTER;
+
+    if (nrfx_timer_init(&timer, &timer_cfg, timer_event_handler) != NRFX_SUCCESS ||
+        nrfx_timer_init(&counter, &counter_cfg, timer_event_handler) != NRFX_SUCCESS) {
+        LOG_ERR("Timestamp timer init failed");
+        return -EIO;
+    }
+
+    if (nrfx_gpiote_channel_get(&gpiote, pin, &gpiote_ch) != NRFX_SUCCESS) {
+        LOG_WRN("No GPIOTE channel for pin %d - hardware timestamps disabled", pin);
+        return -ENOENT;
+    }
+
+    if (nrfx_gppi_channel_alloc(&edge_ch) != NRFX_SUCCESS ||
+        nrfx_gppi_channel_alloc(&anchor_ch) != NRFX_SUCCESS) {
+        LOG_WRN("No free PPI channel - hardware timestamps disabled");
+        return -EBUSY;
+    }
+
+    /* Button edge: latch the time and the number of connection events so far */
+    nrfx_gppi_channel_endpoints_setup(edge_ch,
+        nrfx_gpiote_in_event_address_get(&gpiote, pin),
+        nrfx_timer_task_address_get(&timer, NRF_TIMER_TASK_CAPTURE0));
+    nrfx_gppi_fork_endpoint_setup(edge_ch,
+        nrfx_timer_task_address_get(&counter, NRF_TIMER_TASK_CAPTURE0));
+
+    /* Connection event start: latch the anchor time and count the event */
+    nrfx_gppi_channel_endpoints_setup(anchor_ch,
+        nrf_egu_event_address_get(ANCHOR_EGU, NRF_EGU_EVENT_TRIGGERED0),
+        nrfx_timer_task_address_get(&timer, NRF_TIMER_TASK_CAPTURE2));
+    nrfx_gppi_fork_endpoint_setup(anchor_ch,
+        nrfx_timer_task_address_get(&counter, NRF_TIMER_TASK_COUNT));
+
+    nrfx_gppi_channels_enable(BIT(edge_ch) | BIT(anchor_ch));
+
+    initialized = true;
+    LOG_INF("Hardware timestamps: GPIOTE ch %d -> PPI ch %d -> TIMER%d CC0, "
+            "EGU%d -> PPI ch %d -> TIMER%d CC2 + TIMER%d count",
+            gpiote_ch, edge_ch, TIMESTAMP_TIMER_INSTANCE,
+            TIMESTAMP_EGU_INSTANCE, anchor_ch, TIMESTAMP_TIMER_INSTANCE,
+            TIMESTAMP_COUNTER_INSTANCE);
+    return 0;
+}
+
+void timestamp_start(void)
+{
+    if (!initialized || running) {
+        return;
+    }
+
+    struct onoff_manager *mgr = z_nrf_clock_control_get_onoff(CLOCK_CONTROL_NRF_SUBSYS_HF);
+
+    sys_notify_init_spinwait(&hfclk_cli.notify);
+    onoff_request(mgr, &hfclk_cli);
+
+    nrfx_timer_clear(&timer);
+    nrfx_timer_clear(&counter);
+    nrfx_timer_enable(&timer);
+    nrfx_timer_enable(&counter);
+    running = true;
+}
+
+void timestamp_stop(void)
+{
+    if (!running) {
+        return;
+    }
+
+    nrfx_timer_disable(&timer);
+    nrfx_timer_disable(&counter);
+    onoff_release(z_nrf_clock_control_get_onoff(CLOCK_CONTROL_NRF_SUBSYS_HF));
+    running = false;
+}
+
+void timestamp_restart_events(void)
+{
+    if (running) {
+        nrfx_timer_clear(&counter);
+    }
+}
+
+bool timestamp_is_running(void)
+{
+    return running;
+}
+
+int timestamp_anchor_enable(struct bt_conn *conn)
+{
+    sdc_hci_cmd_vs_set_event_start_task_t *cp;
+    struct net_buf *buf;
+    uint16_t handle;
+    int err;
+
+    if (!initialized) {
+        return -ENODEV;
+    }
+
+    err = bt_hci_get_conn_handle(conn, &handle);
+    if (err) {
+        return err;
+    }
+
+    buf = bt_hci_cmd_create(SDC_HCI_OPCODE_CMD_VS_SET_EVENT_START_TASK, sizeof(*cp));
+    if (!buf) {
+        return -ENOBUFS;
+    }
+
+    cp = net_buf_add(buf, sizeof(*cp));
+    cp->handle = sys_cpu_to_le16(handle);
+    cp->handle_type = SDC_HCI_VS_SET_EVENT_START_TASK_HANDLE_TYPE_CONN;
+    cp->task_address = sys_cpu_to_le32(
+        nrf_egu_task_address_get(ANCHOR_EGU, NRF_EGU_TASK_TRIGGER0));
+
+    err = bt_hci_cmd_send_sync(SDC_HCI_OPCODE_CMD_VS_SET_EVENT_START_TASK, buf, NULL);
+    if (err) {
+        LOG_ERR("Failed to enable connection anchor capture (err %d)", err);
+    }
+
+    return err;
+}
+
+void timestamp_set_conn_interval(uint32_t interval_us)
+{
+    conn_interval_us = interval_us;
+}
+
+void timestamp_latch_edge(struct press_timestamp *ts)
+{
+    uint32_t anchor_us;
+    uint32_t events_now;
+
+    /* Read the latest anchor together with its event number */
+    do {
+        events_now = nrfx_timer_capture(&counter, CC_EVENTS_NOW);
+        anchor_us = nrfx_timer_capture_get(&timer, CC_ANCHOR);
+    } while (nrfx_timer_capture(&counter, CC_EVENTS_NOW) != events_now);
+
+    ts->edge_us = nrfx_timer_capture_get(&timer, CC_EDGE);
+    ts->conn_event = nrfx_timer_capture_get(&counter, CC_EVENTS_AT_EDGE);
+
+    if (ts->conn_event == 0) {
+        ts->anchor_offset_us = 0;
+        return;
+    }
+
+    /* Connection events that started between the edge and this call have
+     * already overwritten the anchor capture, step back to the edge's event.
+     */
+    anchor_us -= (events_now - ts->conn_event) * conn_interval_us;
+    ts->anchor_offset_us = ts->edge_us - anchor_us;
+}
+
+uint32_t timestamp_now(void)
+{
+    return nrfx_timer_capture(&timer, CC_NOW);
+}
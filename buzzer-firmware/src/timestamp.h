@@ -0,0 +1,93 @@
+/**
+ * Hardware press timestamping module
+ * 
+ * The button GPIOTE IN event is routed through (D)PPI to a TIMER CAPTURE task,
+ * so the edge time is latched in hardware with no CPU involvement.
+ * 
+ * The start of every connection event is captured the same way, so a press
+ * can be expressed as "N connection events + offset from that anchor point".
+ * Anchor points are scheduled by the central, which lets the host place
+ * presses from different links on its own timeline.
+ */
+
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/conn.h>
+
+/**
+ * Timestamp of one button edge
+ */
+struct press_timestamp {
+    uint32_t edge_us;           /* Edge time, free-running microsecond timer */
+    uint32_t conn_event;        /* Connection events started before the edge (0 = none yet) */
+    uint32_t anchor_offset_us;  /* Time from that event's anchor point to the edge */
+};
+
+/**
+ * Route the GPIOTE event of a pin to the capture timer
+ * Must be called after the pin interrupt has been configured, since the GPIO
+ * driver allocates the GPIOTE channel at that point.
+ * 
+ * @param pin Absolute pin number (P0.x = x)
+ * @return 0 on success, negative errno on failure
+ */
+int timestamp_init(uint32_t pin);
+
+/**
+ * Start the 1 MHz capture timer and the connection event counter
+ * Requests the HFXO so timestamps do not drift with the internal RC oscillator.
+ */
+void timestamp_start(void);
+
+/**
+ * Stop the capture timer and release the HFXO (saves ~0.3 mA)
+ */
+void timestamp_stop(void);
+
+/**
+ * Restart the connection event count at 0
+ * Call once the link takes part in every connection event again (no
+ * peripheral latency); earlier counts do not match the central's.
+ */
+void timestamp_restart_events(void);
+
+/**
+ * Check whether captured timestamps are valid
+ */
+bool timestamp_is_running(void);
+
+/**
+ * Ask the controller to trigger an anchor capture at the start of every
+ * connection event of a link
+ * 
+ * @param conn Connection to follow
+ * @return 0 on success, negative errno on failure
+ */
+int timestamp_anchor_enable(struct bt_conn *conn);
+
+/**
+ * Set the connection interval used to resolve anchors captured after the edge
+ * 
+ * @param interval_us Connection interval in microseconds
+ */
+void timestamp_set_conn_interval(uint32_t interval_us);
+
+/**
+ * Latch the timestamp of the most recent pin edge
+ * Call from the pin interrupt, before later connection events overwrite the
+ * anchor capture.
+ * 
+ * @param ts Filled with the edge timestamp
+ */
+void timestamp_latch_edge(struct press_timestamp *ts);
+
+/**
+ * Get the current timer value
+ * 
+ * @return Current time in microseconds, same timebase as edge_us
+ */
+uint32_t timestamp_now(void);
+
+#endif /* TIMESTAMP_H */
@@ -0,0 +1,208 @@
+/**
+ * Event transport implementation
+ * 
+ * Queues are only filled from the event thread and emptied there or on
+ * the system workqueue (after transport_resume()). Both are cooperative,
+ * but a send() may still sleep (the receiver's TX lock), so a flush that
+ * finds another one running on the same transport leaves the queue to it.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "config.h"
+#include "transport.h"
+
+LOG_MODULE_REGISTER(transport, BUZZER_LOG_LEVEL);
+
+static struct transport *transports[TRANSPORT_MAX];
+static size_t transport_count;
+
+static void resume_work_handler(struct k_work *work);
+static K_WORK_DEFINE(resume_work, resume_work_handler);
+
+/* Offer the queued events of one transport, batch by batch */
+static void flush(struct transport *t)
+{
+    struct transport_event batch[TRANSPORT_QUEUE_LEN];
+    size_t offered;
+    size_t taken;
+    timing_t start;
+    timing_t end;
+    uint32_t cycles;
+
+    do {
+        if (atomic_test_and_set_bit(&t->flushing, 0)) {
+            return;
+        }
+
+        while (t->count > 0 && !t->busy) {
+            offered = MIN(t->count, CLAMP(t->batch_max, 1, TRANSPORT_QUEUE_LEN));
+
+            unsigned int key = irq_lock();
+
+            for (size_t i = 0; i < offered; i++) {
+                batch[i] = t->queue[(t->head + i) % t->queue_len];
+            }
+            irq_unlock(key);
+
+            start = timing_counter_get();
+            taken = t->send(batch, offered);
+            end = timing_counter_get();
+            cycles = timing_cycles_get(&start, &end);
+
+            key = irq_lock();
+            taken = MIN(taken, offered);
+            t->head = (t->head + taken) % t->queue_len;
+            t->count -= taken;
+            t->stats.batches++;
+            t->stats.events += taken;
+            t->stats.send_cycles += cycles;
+            if (taken && cycles / taken > t->stats.max_cycles) {
+                t->stats.max_cycles = cycles / taken;
+            }
+            if (taken < offered) {
+                /* Back-pressure: wait for transport_resume() */
+                t->busy = true;
+                t->stats.busy++;
+            }
+            irq_unlock(key);
+        }
+
+        atomic_clear_bit(&t->flushing, 0);
+
+        /* An event queued while another flush ran is picked up here */
+    } while (t->count > 0 && !t->busy);
+}
+
+/* Resume work handler - flush the transports that are no longer busy */
+static void resume_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    for (size_t i = 0; i < transport_count; i++) {
+        flush(transports[i]);
+    }
+}
+
+int transport_register(struct transport *transport)
+{
+    if (transport_count == ARRAY_SIZE(transports)) {
+        LOG_ERR("No room for transport %s", transport->name);
+        return -ENOMEM;
+    }
+
+    if (!transport->queue || !transport->queue_len) {
+        LOG_ERR("Transport %s has no queue", transport->name);
+        return -EINVAL;
+    }
+
+    if (transport_count == 0) {
+        /* Cycle counter for the send() statistics (DWT on the board) */
+        timing_init();
+        timing_start();
+    }
+
+    transport->head = 0;
+    transport->count = 0;
+    transport->busy = false;
+    atomic_clear(&transport->flushing);
+    transports[transport_count++] = transport;
+
+    LOG_INF("Transport %s registered (batch %u, queue %u)", transport->name,
+            transport->batch_max, transport->queue_len);
+    return 0;
+}
+
+int transport_submit(const struct transport_event *event)
+{
+    bool release = event->record.type != PRESS_EVENT_TYPE_PRESS;
+    int err = 0;
+
+    for (size_t i = 0; i < transport_count; i++) {
+        struct transport *t = transports[i];
+
+        if ((release && (t->flags & TRANSPORT_FLAG_PRESSES_ONLY)) ||
+            (t->is_active && !t->is_active())) {
+            continue;
+        }
+
+        unsigned int key = irq_lock();
+
+        if (t->count == t->queue_len) {
+            t->stats.dropped++;
+            irq_unlock(key);
+            LOG_WRN("Transport %s full, event seq %u dropped", t->name,
+                    sys_le16_to_cpu(event->record.seq));
+            err = -ENOBUFS;
+            continue;
+        }
+        t->queue[(t->head + t->count) % t->queue_len] = *event;
+        t->count++;
+        irq_unlock(key);
+
+        flush(t);
+    }
+
+    return err;
+}
+
+void transport_resume(struct transport *transport)
+{
+    if (!transport->busy) {
+        return;
+    }
+
+    transport->busy = false;
+    k_work_submit(&resume_work);
+}
+
+void transport_add_send_time(struct transport *transport, timing_t *start, timing_t *end)
+{
+    uint32_t cycles = timing_cycles_get(start, end);
+    unsigned int key = irq_lock();
+
+    transport->stats.send_cycles += cycles;
+    if (cycles > transport->stats.max_cycles) {
+        transport->stats.max_cycles = cycles;
+    }
+    irq_unlock(key);
+}
+
+bool transport_connectionless_active(void)
+{
+    for (size_t i = 0; i < transport_count; i++) {
+        struct transport *t = transports[i];
+
+        if ((t->flags & TRANSPORT_FLAG_CONNECTIONLESS) &&
+            (!t->is_active || t->is_active())) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void transport_log_stats(void)
+{
+    for (size_t i = 0; i < transport_count; i++) {
+        struct transport_stats stats;
+
+        unsigned int key = irq_lock();
+
+        stats = transports[i]->stats;
+        irq_unlock(key);
+
+        if (!stats.events) {
+            continue;
+        }
+
+        LOG_INF("Transport %s: %u events in %u batches, %u busy, %u dropped, "
+                "avg=%uns/event max=%uns/event",
+                transports[i]->name, stats.events, stats.batches, stats.busy,
+                stats.dropped,
+                (uint32_t)(timing_cycles_to_ns(stats.send_cycles) / stats.events),
+                (uint32_t)timing_cycles_to_ns(stats.max_cycles));
+    }
+}
@@ -0,0 +1,148 @@
+/**
+ * Event transport layer
+ * 
+ * Every button change is built once as a press event record (with one
+ * sequence number) by buzzer_service_send_button_state() and handed to all
+ * registered transports: GATT notifications, press broadcasts, PAwR
+ * responses and the wired receiver. A new path registers a struct transport
+ * from its init function; the input and LED code do not change.
+ * 
+ * Each transport has a queue in front of it, owned by the backend. send()
+ * is given up to
+ * batch_max queued events at once and returns how many it took; taking
+ * fewer is back-pressure, the rest stays queued until the transport calls
+ * transport_resume(). The time spent in send() is measured per event with
+ * the timing API (CPU cycles), so the overhead of every backend can be
+ * compared (transport_log_stats()). A backend whose send() only queues adds
+ * the time of the deferred radio call with transport_add_send_time().
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <zephyr/types.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/timing/timing.h>
+
+#include "config.h"
+#include "press_event.h"
+
+/* Transport flags */
+#define TRANSPORT_FLAG_PRESSES_ONLY    BIT(0)  /* Releases are not sent */
+#define TRANSPORT_FLAG_CONNECTIONLESS  BIT(1)  /* Reaches hosts without a connection */
+
+/**
+ * Event as handed to the transports
+ */
+struct transport_event {
+    struct press_event_record record;  /* Sequence number set, age 0 */
+    uint8_t buzzer_id;                 /* Buzzer the event came from */
+    int64_t uptime_ms;                 /* k_uptime_get() when the event was produced */
+    uint32_t queued_cycles;            /* k_cycle_get_32() when the event was produced */
+    uint32_t link_generation;          /* Host link the record's timestamps were taken on */
+};
+
+/**
+ * Per-transport statistics since boot
+ */
+struct transport_stats {
+    uint32_t events;        /* Events taken by send() */
+    uint32_t batches;       /* send() calls */
+    uint32_t busy;          /* send() calls that took fewer events than offered */
+    uint32_t dropped;       /* Events lost to a full transport queue */
+    uint64_t send_cycles;   /* Time spent sending (timing_counter_get() cycles) */
+    uint32_t max_cycles;    /* Longest send() call per event taken, or deferred call */
+};
+
+/**
+ * Transport backend
+ * Statically allocated by the backend; only name, send, is_active,
+ * batch_max, flags, queue and queue_len are set by it.
+ */
+struct transport {
+    const char *name;
+
+    /**
+     * Send events, in order
+     * Called from the event thread, or from the system workqueue after
+     * transport_resume().
+     *
+     * @param events Events, oldest first
+     * @param count Number of events, at most batch_max
+     * @return Number of events taken (fewer than count when busy)
+     */
+    size_t (*send)(const struct transport_event *events, size_t count);
+
+    /**
+     * Check whether events are wanted right now (NULL: always)
+     * Events are not queued for an inactive transport.
+     */
+    bool (*is_active)(void);
+
+    uint8_t batch_max;          /* Events per send() call, at most TRANSPORT_QUEUE_LEN */
+    uint8_t flags;              /* TRANSPORT_FLAG_* */
+    struct transport_event *queue;  /* Events waiting while busy */
+    uint8_t queue_len;          /* Entries in queue */
+
+    /* Owned by transport.c */
+    uint8_t head;
+    uint8_t count;
+    bool busy;
+    atomic_t flushing;
+    struct transport_stats stats;
+};
+
+/**
+ * Add a transport
+ * Call from the backend's init function.
+ * 
+ * @param transport Transport, must stay valid
+ * @return 0 on success, -ENOMEM if TRANSPORT_MAX are registered already,
+ *         -EINVAL without a queue
+ */
+int transport_register(struct transport *transport);
+
+/**
+ * Hand an event to every active transport
+ * Call from the event thread (the only producer of events).
+ * 
+ * @param event Event, record numbered
+ * @return 0 on success, -ENOBUFS if a transport had to drop it
+ */
+int transport_submit(const struct transport_event *event);
+
+/**
+ * Signal that a busy transport can take events again (any context)
+ * The queued events are sent from the system workqueue.
+ * 
+ * @param transport Transport that returned fewer events than offered
+ */
+void transport_resume(struct transport *transport);
+
+/**
+ * Add the time of a deferred send to a transport's statistics
+ * For backends whose send() only queues events that go on air later (the
+ * GATT notification), so their per-event figure includes it.
+ * 
+ * @param transport Transport the event was taken by
+ * @param start timing_counter_get() before the call
+ * @param end timing_counter_get() after the call
+ */
+void transport_add_send_time(struct transport *transport, timing_t *start, timing_t *end);
+
+/**
+ * Check whether a connectionless transport currently reaches hosts
+ * The GATT transport only queues events for a later connection when none
+ * does.
+ * 
+ * @return true if an active transport has TRANSPORT_FLAG_CONNECTIONLESS
+ */
+bool transport_connectionless_active(void);
+
+/**
+ * Log the statistics and per-event overhead of every transport
+ */
+void transport_log_stats(void);
+
+#endif /* TRANSPORT_H */
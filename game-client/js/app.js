@@ -413,6 +413,11 @@ class QuizApp {
         if (greenButton) greenButton.disabled = false;
         if (redButton) redButton.disabled = false;
         
+        // Open the round on the buzzers (first press only, low-latency link)
+        if (this.buzzerManager) {
+            this.buzzerManager.setGameStateAll('armed');
+        }
+        
         // Start timer
         this.startTimer();
     }
@@ -462,7 +467,7 @@ class QuizApp {
     /**
      * Submit an answer for current question
      */
-    submitAnswer(answer) {
+    submitAnswer(answer, reactionUs = null) {
         // Prevent multiple submissions for the same question
         if (this.answerSubmitted) {
             console.log('Answer already submitted for this question, ignoring duplicate submission');
@@ -484,8 +489,21 @@ class QuizApp {
         if (greenButton) greenButton.disabled = true;
         if (redButton) redButton.disabled = true;
         
-        // Calculate time taken
-        const timeTaken = (Date.now() - this.questionStartTime) / 1000;
+        // Close the round on the buzzers (power-saving link until the next question)
+        if (this.buzzerManager) {
+            if (answer === 'green' || answer === 'red') {
+                const other = answer === 'green' ? 'red' : 'green';
+                this.buzzerManager.setGameState(answer, 'winner');
+                this.buzzerManager.setGameState(other, 'locked');
+            } else {
+                this.buzzerManager.setGameStateAll('idle');
+            }
+        }
+        
+        // Calculate time taken: the buzzer's own arm-to-press measurement when
+        // available, free of BLE latency and browser scheduling
+        const timeTaken = reactionUs !== null ?
+            reactionUs / 1000000 : (Date.now() - this.questionStartTime) / 1000;
         
         // Store answer
         const question = this.questions[this.currentQuestionIndex];
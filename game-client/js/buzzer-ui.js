@@ -26,8 +26,8 @@ class BuzzerUI {
         });
         
         // Listen to button presses
-        this.buzzer.onButtonPress((color) => {
-            this.handleBuzzerPress(color);
+        this.buzzer.onButtonPress((color, pressTime, reactionUs) => {
+            this.handleBuzzerPress(color, reactionUs);
         });
     }
     
@@ -96,6 +96,14 @@ class BuzzerUI {
             });
         }
         
+        // Hub (buzzers connected to the hub instead of the browser)
+        const connectHubButton = document.getElementById('connectHub');
+        if (connectHubButton) {
+            connectHubButton.addEventListener('click', async () => {
+                await this.connectHub();
+            });
+        }
+        
         // Disconnect all
         const disconnectAllButton = document.getElementById('disconnectAllBuzzers');
         if (disconnectAllButton) {
@@ -142,6 +150,19 @@ class BuzzerUI {
         }
     }
     
+    async connectHub() {
+        try {
+            await this.buzzer.connectHub();
+            this.app.showToast('Hub connected!', 'success');
+        } catch (error) {
+            console.error('Failed to connect hub:', error);
+            if (error.message && error.message.includes('User cancelled')) {
+                return;
+            }
+            this.app.showError('Failed to connect hub. Please try again.');
+        }
+    }
+    
     async testBuzzers() {
         const testButton = document.getElementById('testBuzzers');
         if (testButton) {
@@ -244,7 +265,7 @@ class BuzzerUI {
         const testBtn = document.getElementById('testBuzzers');
         const disconnectAllBtn = document.getElementById('disconnectAllBuzzers');
         
-        const anyConnected = status.green.connected || status.red.connected;
+        const anyConnected = status.green.connected || status.red.connected || status.hub.connected;
         const bothConnected = status.green.connected && status.red.connected;
         
         if (testBtn) {
@@ -254,9 +275,14 @@ class BuzzerUI {
         if (disconnectAllBtn) {
             disconnectAllBtn.disabled = !anyConnected;
         }
+        
+        const connectHubBtn = document.getElementById('connectHub');
+        if (connectHubBtn) {
+            connectHubBtn.disabled = status.hub.connected;
+        }
     }
     
-    handleBuzzerPress(color) {
+    handleBuzzerPress(color, reactionUs = null) {
         console.log(`Buzzer press received: ${color}`);
         
         // Only handle if we're on the game page
@@ -267,7 +293,7 @@ class BuzzerUI {
         }
         
         // Submit answer through the app
-        this.app.submitAnswer(color);
+        this.app.submitAnswer(color, reactionUs);
     }
     
     /**
@@ -278,6 +304,12 @@ class BuzzerUI {
             return;
         }
         
+        // Played by the buzzer's pattern engine when it has one: a strobe for
+        // a correct answer, a short blink for a wrong one
+        if (await this.buzzer.playNamedPattern(color, isCorrect ? 'winnerStrobe' : 'blink')) {
+            return;
+        }
+        
         if (isCorrect) {
             // Green flash for correct answer
             await this.buzzer.flashLED(color, [0, 255, 0], 500);
@@ -10,6 +10,37 @@ class BuzzerManager {
         this.BUTTON_STATE_UUID = '6e400002-b5a3-f393-e0a9-e50e24dcca9e';
         this.LED_CONTROL_UUID = '6e400003-b5a3-f393-e0a9-e50e24dcca9e';
         this.BUZZER_ID_UUID = '6e400004-b5a3-f393-e0a9-e50e24dcca9e';
+        this.BUTTON_EVENT_UUID = '6e400005-b5a3-f393-e0a9-e50e24dcca9e';
+        this.LED_PATTERN_UUID = '6e400006-b5a3-f393-e0a9-e50e24dcca9e';
+        this.LINK_MODE_UUID = '6e400007-b5a3-f393-e0a9-e50e24dcca9e';
+        this.GAME_STATE_UUID = '6e400008-b5a3-f393-e0a9-e50e24dcca9e';
+        this.IDENTITY_UUID = '6e400009-b5a3-f393-e0a9-e50e24dcca9e';
+        this.DEVICE_INFO_UUID = '6e40000a-b5a3-f393-e0a9-e50e24dcca9e';
+        
+        // Hub variant of the firmware (one merged, ranked press stream)
+        this.HUB_SERVICE_UUID = '6e400010-b5a3-f393-e0a9-e50e24dcca9e';
+        this.HUB_EVENT_UUID = '6e400011-b5a3-f393-e0a9-e50e24dcca9e';
+        this.HUB_CONTROL_UUID = '6e400012-b5a3-f393-e0a9-e50e24dcca9e';
+        
+        // Company ID of the advertised manufacturer data (Bluetooth SIG test ID)
+        this.ADV_COMPANY_ID = 0xffff;
+        
+        // Device Info capability bits, see firmware src/device_info.h
+        this.CAPS = {
+            buttonEvent: 1 << 0,
+            hwTimestamp: 1 << 1,
+            ledPattern: 1 << 2,
+            linkMode: 1 << 3,
+            phyDiag: 1 << 4,
+            gameState: 1 << 5,
+            reactionTime: 1 << 6,
+            roundId: 1 << 7,
+            identity: 1 << 8,
+            bonding: 1 << 9
+        };
+        
+        // Game State values, see firmware Game State characteristic
+        this.GAME_STATES = { idle: 0, armed: 1, locked: 2, winner: 3 };
         this.BATTERY_SERVICE_UUID = '0000180f-0000-1000-8000-00805f9b34fb';
         this.BATTERY_LEVEL_UUID = '00002a19-0000-1000-8000-00805f9b34fb';
         
@@ -17,6 +48,9 @@ class BuzzerManager {
         this.greenBuzzer = null;
         this.redBuzzer = null;
         
+        // Connected hub, if any: buzzer ID 1 presses count for green, 2 for red
+        this.hub = null;
+        
         // Device objects
         this.greenDevice = null;
         this.redDevice = null;
@@ -36,6 +70,64 @@ class BuzzerManager {
         // Button press callbacks
         this.buttonPressCallbacks = [];
         
+        // Per-buzzer mapping from firmware edge timestamps to performance.now()
+        this.clockSync = {
+            green: null,
+            red: null
+        };
+        
+        // Per-buzzer mapping from connection event numbers to performance.now()
+        this.anchorSync = {
+            green: null,
+            red: null
+        };
+        
+        // Per-buzzer button event sequence tracking (gap detection and replay)
+        this.eventSeq = {
+            green: null,
+            red: null
+        };
+        
+        // Presses arriving within this window are ranked by press time, not
+        // arrival time (covers one connection interval of link skew)
+        this.arbitrationWindowMs = 30;
+        this.pendingPresses = [];
+        this.arbitrationTimer = null;
+        
+        // Round ID written with every armed game state (1-65535, 0 = none yet);
+        // presses tagged with another round are stale
+        this.roundId = 0;
+        
+        // Last game state meant for each buzzer, written again after a
+        // reconnect (the buzzer drops it with the link)
+        this.gameStates = { green: null, red: null };
+        
+        // Automatic reconnect after link loss (the buzzer advertises directed
+        // toward its bonded central first, see firmware src/advertising.c)
+        this.reconnectAttempts = 30;
+        this.reconnectDelayMs = 200;
+        this.reconnectTimes = [];
+        
+        // Connect-to-subscribed and connect-to-first-event times (ms), first
+        // connections and reconnects kept apart to compare GATT caching builds
+        this.connectBenchmark = {
+            initial: { subscribed: [], firstEvent: [] },
+            reconnect: { subscribed: [], firstEvent: [] }
+        };
+        
+        // LED animations played on the buzzer itself (level 0-255, duration in ms,
+        // repeat 0 loops until stopped), see firmware LED Pattern characteristic
+        this.LED_PATTERNS = {
+            blink: {
+                steps: [{ level: 255, duration: 150 }, { level: 0, duration: 150 }],
+                repeat: 3
+            },
+            winnerStrobe: {
+                steps: [{ level: 255, duration: 50 }, { level: 0, duration: 50 }],
+                repeat: 20
+            }
+        };
+        
         // Status change callbacks
         this.statusChangeCallbacks = [];
         
@@ -58,9 +150,12 @@ class BuzzerManager {
     
     /**
      * Connect to a buzzer device
+     * The chooser only lists buzzers advertising the ID of the slot (1 =
+     * green, 2 = red), so the wrong one cannot be picked by accident.
      * @param {string} color - 'green' or 'red'
+     * @param {boolean} anyBuzzer - List every buzzer (e.g. provisioned to another ID)
      */
-    async connectBuzzer(color) {
+    async connectBuzzer(color, anyBuzzer = false) {
         if (!this.isSupported) {
             throw new Error('Web Bluetooth is not supported in this browser');
         }
@@ -70,19 +165,234 @@ class BuzzerManager {
             
             // Request device with filters
             const device = await navigator.bluetooth.requestDevice({
-                filters: [
+                filters: anyBuzzer ? [
                     { 
                         namePrefix: 'Gravitee Quiz Buzzer',
                         services: [this.BUZZER_SERVICE_UUID]
                     }
-                ],
+                ] : this.slotFilters(color),
                 optionalServices: [this.BATTERY_SERVICE_UUID]
             });
             
-            // Connect to GATT server
-            const server = await device.gatt.connect();
-            console.log(`Connected to ${device.name}`);
+            const buzzerObj = await this.setupBuzzer(device);
+            if (buzzerObj.color !== color) {
+                console.warn(`Picked the ${buzzerObj.color} buzzer for the ${color} slot`);
+            }
+            return buzzerObj;
+            
+        } catch (error) {
+            console.error(`Failed to connect ${color} buzzer:`, error);
+            throw error;
+        }
+    }
+    
+    /**
+     * Connect to a hub (firmware built with overlay-hub.conf)
+     * The hub holds the links to the buzzers, ranks their presses on its own
+     * timer and notifies them as one stream; game states reach all buzzers
+     * with one Hub Control write. Buzzers behind the hub do not need a slot.
+     */
+    async connectHub() {
+        if (!this.isSupported) {
+            throw new Error('Web Bluetooth is not supported in this browser');
+        }
+        
+        const device = await navigator.bluetooth.requestDevice({
+            filters: [{ namePrefix: 'Gravitee Quiz Buzzer', services: [this.BUZZER_SERVICE_UUID] }],
+            optionalServices: [this.HUB_SERVICE_UUID]
+        });
+        const server = await device.gatt.connect();
+        
+        try {
+            const service = await server.getPrimaryService(this.HUB_SERVICE_UUID);
+            const eventChar = await service.getCharacteristic(this.HUB_EVENT_UUID);
+            const controlChar = await service.getCharacteristic(this.HUB_CONTROL_UUID);
+            
+            this.hub = { device, eventChar, controlChar, seen: new Set(), sync: null, state: null };
+            await eventChar.startNotifications();
+            eventChar.addEventListener('characteristicvaluechanged', (event) => {
+                this.handleHubEvent(event.target.value, performance.now());
+            });
+            device.addEventListener('gattserverdisconnected', () => {
+                console.log('Hub disconnected');
+                this.hub = null;
+                this.notifyStatusChange();
+            }, { once: true });
+            
+            // Joining a running game: the buzzers get its state through the hub
+            const winner = ['green', 'red'].find(color => this.gameStates[color] === 'winner');
+            if (winner) {
+                await this.writeHubControl('winner', winner === 'green' ? 1 : 2);
+            } else if (this.gameStates.green) {
+                await this.writeHubControl(this.gameStates.green);
+            }
             
+            console.log(`Connected to hub ${device.name}`);
+            this.notifyStatusChange();
+            return this.hub;
+        } catch (error) {
+            this.hub = null;
+            device.gatt.disconnect();
+            throw error;
+        }
+    }
+    
+    /**
+     * Disconnect the hub
+     */
+    async disconnectHub() {
+        if (this.hub && this.hub.device.gatt.connected) {
+            await this.hub.device.gatt.disconnect();
+        }
+        this.hub = null;
+        this.notifyStatusChange();
+    }
+    
+    /**
+     * Write the game state for all buzzers behind the hub
+     * @param {string} state - 'idle', 'armed', 'locked' or 'winner'
+     * @param {number} winnerId - Buzzer that won (state 'winner'), the others are locked
+     */
+    async writeHubControl(state, winnerId = 0) {
+        if (!this.hub) {
+            return;
+        }
+        
+        this.hub.state = state;
+        try {
+            const data = [this.GAME_STATES[state], this.roundId & 0xff, this.roundId >> 8, winnerId];
+            await this.hub.controlChar.writeValueWithoutResponse(new Uint8Array(data));
+        } catch (error) {
+            console.error(`Failed to set ${state} game state on the hub:`, error);
+        }
+    }
+    
+    /**
+     * Handle a Hub Event notification (firmware struct hub_event)
+     * 
+     * The hub sends presses in rank order with the estimated press time on
+     * its own timer (press_us), the same clock for every buzzer. That clock is
+     * mapped onto performance.now() from the smallest arrival minus capture
+     * time seen, as in mapEdgeTimestamp(). A press that reached the hub over
+     * several paths (GATT, broadcast, PAwR) is only counted once.
+     * @param {DataView} value - Hub Event notification value
+     * @param {number} arrivalTime - performance.now() when the notification arrived
+     */
+    handleHubEvent(value, arrivalTime) {
+        const DRIFT_ALLOWANCE = 100e-6;
+        
+        if (value.byteLength < 12 + 20 || value.getUint8(0) !== 1) {
+            console.warn('Hub sent an unsupported event record');
+            return;
+        }
+        
+        const buzzerId = value.getUint8(1);
+        const rank = value.getUint8(3);
+        const captureUs = value.getUint32(4, true);
+        const pressUs = value.getUint32(8, true);
+        const record = this.parseButtonEvent(
+            new DataView(value.buffer, value.byteOffset + 12, value.byteLength - 12));
+        const color = buzzerId === 1 ? 'green' : buzzerId === 2 ? 'red' : null;
+        
+        if (!record || !color) {
+            console.warn(`Hub: ignoring press of buzzer ${buzzerId} (no team slot)`);
+            return;
+        }
+        
+        const key = `${buzzerId}:${record.seq}`;
+        if (this.hub.seen.has(key)) {
+            return;
+        }
+        this.hub.seen.add(key);
+        if (this.hub.seen.size > 256) {
+            this.hub.seen.delete(this.hub.seen.values().next().value);
+        }
+        
+        if (record.roundId && this.roundId && record.roundId !== this.roundId) {
+            console.warn(`Hub: ignoring buzzer ${buzzerId} seq ${record.seq} from round ${record.roundId}`);
+            return;
+        }
+        
+        // Unwrap the 32-bit hub timer with signed steps (events arrive in
+        // rank order, not capture order)
+        let sync = this.hub.sync;
+        if (!sync) {
+            sync = { lastUs: captureUs, hubMs: 0, offset: Infinity, lastArrival: arrivalTime };
+            this.hub.sync = sync;
+        }
+        sync.hubMs += ((captureUs - sync.lastUs) | 0) / 1000;
+        sync.lastUs = captureUs;
+        
+        const elapsed = arrivalTime - sync.lastArrival;
+        sync.lastArrival = arrivalTime;
+        sync.offset = Math.min(arrivalTime - sync.hubMs, sync.offset + elapsed * DRIFT_ALLOWANCE);
+        
+        const pressTime = sync.hubMs + sync.offset - ((captureUs - pressUs) | 0) / 1000;
+        
+        console.log(`Hub: ${color} buzzer pressed (rank ${rank}, seq ${record.seq})`);
+        this.handleButtonPress(color, pressTime, record.reactionUs);
+    }
+    
+    /**
+     * Chooser filters for one slot
+     * Matches the advertised manufacturer data (company ID 0xFFFF, version 1,
+     * buzzer ID), and the default name for firmware that does not advertise
+     * its ID yet.
+     * @param {string} color - 'green' or 'red'
+     * @returns {Array} Filters for requestDevice()
+     */
+    slotFilters(color) {
+        const buzzerId = color === 'green' ? 1 : 2;
+        
+        return [
+            {
+                services: [this.BUZZER_SERVICE_UUID],
+                manufacturerData: [{
+                    companyIdentifier: this.ADV_COMPANY_ID,
+                    dataPrefix: new Uint8Array([1, buzzerId])
+                }]
+            },
+            {
+                name: color === 'green' ? 'Gravitee Quiz Buzzer - Green' : 'Gravitee Quiz Buzzer - Red',
+                services: [this.BUZZER_SERVICE_UUID]
+            }
+        ];
+    }
+    
+    /**
+     * Parse the manufacturer data a buzzer advertises
+     * Available before connecting, e.g. from device.watchAdvertisements().
+     * @param {BluetoothManufacturerDataMap} manufacturerData - Advertised manufacturer data
+     * @returns {Object|null} Buzzer ID, battery level and flags, or null if absent
+     */
+    parseAdvertisedInfo(manufacturerData) {
+        const value = manufacturerData && manufacturerData.get(this.ADV_COMPANY_ID);
+        if (!value || value.byteLength < 4 || value.getUint8(0) !== 1) {
+            return null;
+        }
+        
+        const flags = value.getUint8(3);
+        return {
+            buzzerId: value.getUint8(1),
+            battery: value.getUint8(2),
+            ready: (flags & 0x01) !== 0,
+            bonded: (flags & 0x02) !== 0,
+            lowBattery: (flags & 0x04) !== 0
+        };
+    }
+    
+    /**
+     * Connect to the GATT server of a chosen device and subscribe to it
+     * Used for the first connection and for reconnects.
+     * @param {BluetoothDevice} device - Device returned by requestDevice()
+     */
+    async setupBuzzer(device) {
+        // Connect to GATT server
+        const connectStart = performance.now();
+        const server = await device.gatt.connect();
+        console.log(`Connected to ${device.name}`);
+        
+        try {
             // Get buzzer service
             const service = await server.getPrimaryService(this.BUZZER_SERVICE_UUID);
             
@@ -91,12 +401,45 @@ class BuzzerManager {
             const ledChar = await service.getCharacteristic(this.LED_CONTROL_UUID);
             const idChar = await service.getCharacteristic(this.BUZZER_ID_UUID);
             
-            // Read buzzer ID to verify which buzzer this is
-            const idValue = await idChar.readValue();
-            const buzzerId = idValue.getUint8(0);
+            // Versioned button event records (older firmware only has Button State)
+            const eventChar = await service.getCharacteristic(this.BUTTON_EVENT_UUID).catch(() => null);
+            
+            // On-device LED animations (older firmware only has LED Control)
+            const patternChar = await service.getCharacteristic(this.LED_PATTERN_UUID).catch(() => null);
+            
+            // Armed / idle connection parameters (optional, newer firmware)
+            const linkModeChar = await service.getCharacteristic(this.LINK_MODE_UUID).catch(() => null);
+            
+            // Press gating on the buzzer (optional, newer firmware)
+            const gameStateChar = await service.getCharacteristic(this.GAME_STATE_UUID).catch(() => null);
+            
+            // Provisioned ID, colour and name (optional, newer firmware)
+            const identityChar = await service.getCharacteristic(this.IDENTITY_UUID).catch(() => null);
+            
+            // ID, colour, battery and modes in one read (optional, newer firmware)
+            const deviceInfoChar = await service.getCharacteristic(this.DEVICE_INFO_UUID).catch(() => null);
+            const deviceInfo = deviceInfoChar ? this.parseDeviceInfo(await deviceInfoChar.readValue()) : null;
+            
+            // Read buzzer ID to verify which buzzer this is. The team slot
+            // follows the ID (1 = green, 2 = red), not the stored colour; other
+            // IDs (white by default) have no slot in a two-team game.
+            const buzzerId = deviceInfo ? deviceInfo.buzzerId : (await idChar.readValue()).getUint8(0);
+            if (buzzerId !== 1 && buzzerId !== 2) {
+                throw new Error(`Buzzer ID ${buzzerId} has no team slot, provision it as ID 1 (green) or 2 (red)`);
+            }
             const buzzerColor = buzzerId === 1 ? 'green' : 'red';
+            let buzzerName = device.name;
             
-            console.log(`Buzzer ID: ${buzzerId} (${buzzerColor})`);
+            if (deviceInfo) {
+                console.log(`Firmware ${deviceInfo.firmware}, capabilities 0x${deviceInfo.capabilities.toString(16)}`);
+            } else if (identityChar) {
+                const identity = await identityChar.readValue();
+                if (identity.byteLength >= 4) {
+                    buzzerName = new TextDecoder().decode(new Uint8Array(identity.buffer, identity.byteOffset + 4, identity.byteLength - 4)) || buzzerName;
+                }
+            }
+            
+            console.log(`Buzzer ID: ${buzzerId} (${buzzerColor}, ${buzzerName})`);
             
             // Store device and characteristics
             const buzzerObj = {
@@ -106,7 +449,14 @@ class BuzzerManager {
                 buttonChar,
                 ledChar,
                 idChar,
+                eventChar,
+                patternChar,
+                linkModeChar,
+                gameStateChar,
+                identityChar,
+                deviceInfo,
                 buzzerId,
+                name: buzzerName,
                 color: buzzerColor
             };
             
@@ -116,9 +466,8 @@ class BuzzerManager {
                 const batteryChar = await batteryService.getCharacteristic(this.BATTERY_LEVEL_UUID);
                 buzzerObj.batteryChar = batteryChar;
                 
-                // Read initial battery level
-                const batteryValue = await batteryChar.readValue();
-                const batteryLevel = batteryValue.getUint8(0);
+                // Initial battery level (already known from Device Info)
+                const batteryLevel = deviceInfo ? deviceInfo.battery : (await batteryChar.readValue()).getUint8(0);
                 this.batteryLevels[buzzerColor] = batteryLevel;
                 console.log(`${buzzerColor} battery: ${batteryLevel}%`);
                 
@@ -135,20 +484,46 @@ class BuzzerManager {
             }
             
             // Subscribe to button notifications
-            await buttonChar.startNotifications();
-            buttonChar.addEventListener('characteristicvaluechanged', (event) => {
-                const pressed = event.target.value.getUint8(0) === 1;
-                console.log(`${buzzerColor} button ${pressed ? 'pressed' : 'released'}`);
-                if (pressed) {
-                    this.handleButtonPress(buzzerColor);
-                }
-            });
+            this.clockSync[buzzerColor] = null;
+            this.anchorSync[buzzerColor] = null;
+            this.eventSeq[buzzerColor] = null;
+            if (eventChar) {
+                await eventChar.startNotifications();
+                eventChar.addEventListener('characteristicvaluechanged', (event) => {
+                    this.handleButtonEvent(buzzerObj, event.target.value, performance.now());
+                });
+            } else {
+                await buttonChar.startNotifications();
+                buttonChar.addEventListener('characteristicvaluechanged', (event) => {
+                    const pressed = event.target.value.getUint8(0) === 1;
+                    console.log(`${buzzerColor} button ${pressed ? 'pressed' : 'released'}`);
+                    if (pressed) {
+                        this.handleButtonPress(buzzerColor);
+                    }
+                });
+            }
             
-            // Handle disconnect
-            device.addEventListener('gattserverdisconnected', () => {
-                console.log(`${buzzerColor} buzzer disconnected`);
-                this.handleDisconnect(buzzerColor);
-            });
+            // Time from GATT connect to button notifications being live
+            buzzerObj.connectToSubscribedMs = performance.now() - connectStart;
+            console.log(`${buzzerColor} connect-to-subscribed: ${buzzerObj.connectToSubscribedMs.toFixed(0)} ms`);
+            buzzerObj.connectStart = connectStart;
+            buzzerObj.benchmark = this.connectBenchmark[device.reconnecting ? 'reconnect' : 'initial'];
+            buzzerObj.benchmark.subscribed.push(buzzerObj.connectToSubscribedMs);
+            this.logConnectBenchmark();
+            
+            // Handle disconnect (once per device, setupBuzzer runs again on reconnect)
+            device.buzzerColor = buzzerColor;
+            device.manualDisconnect = false;
+            if (!device.disconnectListener) {
+                device.disconnectListener = () => {
+                    console.log(`${device.buzzerColor} buzzer disconnected`);
+                    this.handleDisconnect(device.buzzerColor);
+                    if (!device.manualDisconnect && !device.reconnecting) {
+                        this.reconnectBuzzer(device);
+                    }
+                };
+                device.addEventListener('gattserverdisconnected', device.disconnectListener);
+            }
             
             // Store buzzer object
             if (buzzerColor === 'green') {
@@ -164,16 +539,102 @@ class BuzzerManager {
             // Flash LED to confirm connection
             await this.flashLED(buzzerColor, buzzerColor === 'green' ? [0, 255, 0] : [255, 0, 0]);
             
+            // A buzzer coming back mid-game reports every press until it has
+            // the game state and round ID again
+            if (this.gameStates[buzzerColor]) {
+                await this.setGameState(buzzerColor, this.gameStates[buzzerColor]);
+            }
+            
             this.notifyStatusChange();
             
             return buzzerObj;
             
         } catch (error) {
-            console.error(`Failed to connect ${color} buzzer:`, error);
+            // Don't leave a half set up link behind
+            device.gatt.disconnect();
             throw error;
         }
     }
     
+    /**
+     * Reconnect a buzzer after link loss
+     * Retries for reconnectAttempts * reconnectDelayMs and logs the time from
+     * link loss to notifications being live again.
+     * @param {BluetoothDevice} device - Device that lost its link
+     */
+    async reconnectBuzzer(device) {
+        const lostAt = performance.now();
+        
+        device.reconnecting = true;
+        try {
+            await this.retryReconnect(device, lostAt);
+        } finally {
+            device.reconnecting = false;
+        }
+    }
+    
+    /**
+     * Reconnect attempts of reconnectBuzzer()
+     * @param {BluetoothDevice} device - Device that lost its link
+     * @param {number} lostAt - performance.now() of the link loss
+     */
+    async retryReconnect(device, lostAt) {
+        for (let attempt = 1; attempt <= this.reconnectAttempts; attempt++) {
+            if (device.manualDisconnect || device.gatt.connected) {
+                return;
+            }
+            
+            try {
+                const buzzerObj = await this.setupBuzzer(device);
+                const ms = performance.now() - lostAt;
+                this.reconnectTimes.push(ms);
+                console.log(`${buzzerObj.color} buzzer reconnected in ${ms.toFixed(0)} ms (attempt ${attempt})`);
+                this.logReconnectStats();
+                return;
+            } catch (error) {
+                console.warn(`${device.buzzerColor} reconnect attempt ${attempt} failed:`, error.message);
+                await new Promise(resolve => setTimeout(resolve, this.reconnectDelayMs));
+            }
+        }
+        
+        console.error(`${device.buzzerColor} buzzer did not come back, connect it again by hand`);
+    }
+    
+    /**
+     * Log the distribution of reconnect times measured so far
+     */
+    logReconnectStats() {
+        console.log(`Reconnect times ${this.summarizeTimes(this.reconnectTimes)}`);
+    }
+    
+    /**
+     * Log the connect benchmark measured so far
+     */
+    logConnectBenchmark() {
+        for (const kind of ['initial', 'reconnect']) {
+            const { subscribed, firstEvent } = this.connectBenchmark[kind];
+            if (subscribed.length) {
+                console.log(`Connect benchmark (${kind}) connect-to-subscribed ${this.summarizeTimes(subscribed)}`);
+            }
+            if (firstEvent.length) {
+                console.log(`Connect benchmark (${kind}) connect-to-first-event ${this.summarizeTimes(firstEvent)}`);
+            }
+        }
+    }
+    
+    /**
+     * Summarize a list of times for the console
+     * @param {Array<number>} list - Times in ms (not empty)
+     * @returns {string} Count, min, median, p90 and max
+     */
+    summarizeTimes(list) {
+        const times = [...list].sort((a, b) => a - b);
+        const at = (p) => times[Math.min(times.length - 1, Math.floor(p * times.length))];
+        return `(n=${times.length}): min ${times[0].toFixed(0)} ms, ` +
+            `median ${at(0.5).toFixed(0)} ms, p90 ${at(0.9).toFixed(0)} ms, ` +
+            `max ${times[times.length - 1].toFixed(0)} ms`;
+    }
+    
     /**
      * Disconnect a buzzer
      * @param {string} color - 'green' or 'red'
@@ -181,6 +642,10 @@ class BuzzerManager {
     async disconnectBuzzer(color) {
         const device = color === 'green' ? this.greenDevice : this.redDevice;
         
+        if (device) {
+            device.manualDisconnect = true;
+        }
+        
         if (device && device.gatt.connected) {
             await device.gatt.disconnect();
         }
@@ -248,12 +713,157 @@ class BuzzerManager {
      * @param {number} duration - Flash duration in ms
      */
     async flashLED(color, rgb, duration = 200) {
+        // One write, the buzzer times the flash itself
+        const level = Math.max(...rgb);
+        if (await this.playLEDPattern(color, [{ level, duration }], 1)) {
+            return;
+        }
+        
         await this.setLED(color, rgb);
         setTimeout(async () => {
             await this.setLED(color, [0, 0, 0]);
         }, duration);
     }
     
+    /**
+     * Play an LED animation on the buzzer (one write for the whole animation)
+     * @param {string} color - 'green' or 'red'
+     * @param {Array} steps - [{ level: 0-255, duration: ms }, ...], at most 8
+     * @param {number} repeat - Times to play the steps, 0 loops until stopped
+     * @returns {Promise<boolean>} false if the buzzer has no pattern engine or
+     *          rejected the pattern
+     */
+    async playLEDPattern(color, steps, repeat = 1) {
+        const buzzer = color === 'green' ? this.greenBuzzer : this.redBuzzer;
+        
+        if (!buzzer || !buzzer.patternChar) {
+            return false;
+        }
+        
+        // PLAY opcode, buzzer LED (1), repeat, then level + 16-bit duration per step
+        const data = new Uint8Array(3 + steps.length * 3);
+        data[0] = 0x01;
+        data[1] = 1;
+        data[2] = repeat;
+        steps.forEach((step, i) => {
+            data[3 + i * 3] = step.level;
+            data[4 + i * 3] = step.duration & 0xff;
+            data[5 + i * 3] = (step.duration >> 8) & 0xff;
+        });
+        
+        // With response: a rejected pattern comes back as an ATT error only then
+        try {
+            await buzzer.patternChar.writeValueWithResponse(data);
+            return true;
+        } catch (error) {
+            console.error(`Failed to play LED pattern on ${color} buzzer:`, error);
+            return false;
+        }
+    }
+    
+    /**
+     * Play one of the LED_PATTERNS presets
+     * @param {string} color - 'green' or 'red'
+     * @param {string} name - Preset name (blink, winnerStrobe)
+     * @returns {Promise<boolean>} false if the buzzer has no pattern engine
+     */
+    async playNamedPattern(color, name) {
+        const pattern = this.LED_PATTERNS[name];
+        return pattern ? this.playLEDPattern(color, pattern.steps, pattern.repeat) : false;
+    }
+    
+    /**
+     * Switch a buzzer between the armed (7.5 ms interval, no latency) and the
+     * idle (long interval, power saving) connection profile
+     * @param {string} color - 'green' or 'red'
+     * @param {string} mode - 'armed' or 'idle'
+     */
+    async setLinkMode(color, mode) {
+        const buzzer = color === 'green' ? this.greenBuzzer : this.redBuzzer;
+        
+        if (!buzzer || !buzzer.linkModeChar) {
+            return;
+        }
+        
+        try {
+            await buzzer.linkModeChar.writeValueWithoutResponse(new Uint8Array([mode === 'armed' ? 1 : 0]));
+        } catch (error) {
+            console.error(`Failed to set ${mode} link mode on ${color} buzzer:`, error);
+        }
+    }
+    
+    /**
+     * Switch all connected buzzers to a link mode
+     * Call with 'armed' when a question opens and 'idle' when it closes; the
+     * firmware delays idle by a few seconds so back-to-back questions stay armed.
+     * @param {string} mode - 'armed' or 'idle'
+     */
+    async setLinkModeAll(mode) {
+        await Promise.all(['green', 'red']
+            .filter(color => this.connectionStatus[color] === 'connected')
+            .map(color => this.setLinkMode(color, mode)));
+    }
+    
+    /**
+     * Set the game state of a buzzer
+     * Armed lets the first press through and locks the buzzer after it; the
+     * buzzer also switches to the matching link mode. Firmware without the
+     * Game State characteristic only gets the link mode. The current round ID
+     * is sent along so the buzzer tags its presses with it.
+     * @param {string} color - 'green' or 'red'
+     * @param {string} state - 'idle', 'armed', 'locked' or 'winner'
+     */
+    async setGameState(color, state) {
+        const buzzer = color === 'green' ? this.greenBuzzer : this.redBuzzer;
+        
+        this.gameStates[color] = state;
+        
+        // The hub locks every buzzer but the winner by itself
+        if (this.hub && !(state === 'locked' && this.hub.state === 'winner')) {
+            await this.writeHubControl(state, state === 'winner' ? (color === 'green' ? 1 : 2) : 0);
+        }
+        
+        if (!buzzer) {
+            return;
+        }
+        if (!buzzer.gameStateChar) {
+            await this.setLinkMode(color, state === 'armed' ? 'armed' : 'idle');
+            return;
+        }
+        
+        try {
+            const data = this.roundId ?
+                [this.GAME_STATES[state], this.roundId & 0xff, this.roundId >> 8] :
+                [this.GAME_STATES[state]];
+            await buzzer.gameStateChar.writeValueWithoutResponse(new Uint8Array(data));
+        } catch (error) {
+            console.error(`Failed to set ${state} game state on ${color} buzzer:`, error);
+        }
+    }
+    
+    /**
+     * Set the game state of all connected buzzers
+     * Arming starts a new round: presses of earlier rounds still queued on a
+     * buzzer are dropped there, and ignored here if they arrive anyway.
+     * @param {string} state - 'idle', 'armed', 'locked' or 'winner'
+     */
+    async setGameStateAll(state) {
+        if (state === 'armed') {
+            this.roundId = (this.roundId % 0xffff) + 1;
+            this.pendingPresses = [];
+        }
+        
+        // Also meant for buzzers that are reconnecting right now
+        this.gameStates = { green: state, red: state };
+        
+        // One write for all buzzers behind a hub
+        await this.writeHubControl(state);
+        
+        await Promise.all(['green', 'red']
+            .filter(color => this.connectionStatus[color] === 'connected')
+            .map(color => this.setGameState(color, state)));
+    }
+    
     /**
      * Turn off LED
      * @param {string} color - 'green' or 'red'
@@ -262,15 +872,289 @@ class BuzzerManager {
         await this.setLED(color, [0, 0, 0]);
     }
     
+    /**
+     * Decode a button event record (little-endian, see firmware press_event.h)
+     * @param {DataView} value - Button Event notification value
+     * @returns {Object|null} Decoded record, or null for an unknown version
+     */
+    parseButtonEvent(value) {
+        if (value.byteLength < 20 || value.getUint8(0) !== 1) {
+            return null;
+        }
+        return {
+            version: value.getUint8(0),
+            pressed: value.getUint8(1) === 1,
+            seq: value.getUint16(2, true),
+            button: value.getUint8(4),
+            flags: value.getUint8(5),
+            edgeUs: value.getUint32(6, true),
+            connEvent: value.getUint32(10, true),
+            anchorOffsetUs: value.getUint32(14, true),
+            connInterval: value.getUint16(18, true),
+            // Time spent queued on the buzzer, cut off with a default 23-byte MTU
+            ageMs: value.byteLength >= 22 ? value.getUint16(20, true) : null,
+            // Radio diagnostics: PHY (1 = 1M, 2 = 2M, 4 = Coded), RSSI in dBm (127 = unknown)
+            phy: value.byteLength >= 24 ? value.getUint8(22) : null,
+            rssi: value.byteLength >= 24 && value.getInt8(23) !== 127 ? value.getInt8(23) : null,
+            // Armed write received to press edge, measured on the buzzer (flag bit 2)
+            reactionUs: value.byteLength >= 28 && (value.getUint8(5) & 0x04) ? value.getUint32(24, true) : null,
+            // Round the press belongs to (0 = untagged)
+            roundId: value.byteLength >= 30 ? value.getUint16(28, true) : 0
+        };
+    }
+    
+    /**
+     * Parse a Device Info value
+     * Fields past the ones known here are ignored (appended in newer firmware).
+     * @param {DataView} value - Device Info read value
+     * @returns {Object|null} Parsed record, or null for an unknown version
+     */
+    parseDeviceInfo(value) {
+        if (value.byteLength < 20 || value.getUint8(0) !== 1) {
+            return null;
+        }
+        
+        return {
+            buzzerId: value.getUint8(1),
+            color: [value.getUint8(2), value.getUint8(3), value.getUint8(4)],
+            firmware: `${value.getUint8(5)}.${value.getUint8(6)}.${value.getUint8(7)}`,
+            capabilities: value.getUint32(8, true),
+            battery: value.getUint8(12),
+            linkMode: value.getUint8(13),
+            gameState: value.getUint8(14),
+            ledLevel: value.getUint8(15),
+            eventVersion: value.getUint8(16),
+            eventSize: value.getUint8(17),
+            roundId: value.getUint16(18, true)
+        };
+    }
+    
+    /**
+     * Check whether a connected buzzer reports a capability
+     * Buzzers without Device Info report none.
+     * @param {string} color - 'green' or 'red'
+     * @param {string} cap - Key of this.CAPS
+     */
+    hasCapability(color, cap) {
+        const buzzer = color === 'green' ? this.greenBuzzer : this.redBuzzer;
+        return !!(buzzer && buzzer.deviceInfo && (buzzer.deviceInfo.capabilities & this.CAPS[cap]));
+    }
+    
+    /**
+     * Handle a button event record notification
+     * 
+     * Sequence numbers increase by one per event. A jump means events were lost
+     * (notification refused or dropped), so a replay of the missing range is
+     * requested; records already seen (including replays) are ignored.
+     * @param {Object} buzzer - Connected buzzer object
+     * @param {DataView} value - Button Event notification value
+     * @param {number} arrivalTime - performance.now() when the notification arrived
+     */
+    handleButtonEvent(buzzer, value, arrivalTime) {
+        const color = buzzer.color;
+        const record = this.parseButtonEvent(value);
+        if (!record) {
+            console.warn(`${color} buzzer sent an unsupported event record`);
+            return;
+        }
+        
+        // First event on this connection (queued presses arrive right after a reconnect)
+        if (buzzer.benchmark && buzzer.connectStart) {
+            buzzer.benchmark.firstEvent.push(arrivalTime - buzzer.connectStart);
+            buzzer.connectStart = null;
+            this.logConnectBenchmark();
+        }
+        
+        let tracking = this.eventSeq[color];
+        if (!tracking) {
+            tracking = { expected: record.seq, seen: new Set() };
+            this.eventSeq[color] = tracking;
+        }
+        
+        if (tracking.seen.has(record.seq)) {
+            return;
+        }
+        tracking.seen.add(record.seq);
+        if (tracking.seen.size > 256) {
+            tracking.seen.delete(tracking.seen.values().next().value);
+        }
+        
+        // Distance ahead of the expected sequence number, modulo 2^16
+        const gap = (record.seq - tracking.expected) & 0xffff;
+        if (gap > 0 && gap < 0x8000) {
+            console.warn(`${color} buzzer: ${gap} event(s) lost before seq ${record.seq}, requesting replay`);
+            this.requestReplay(buzzer, tracking.expected);
+        }
+        if (gap < 0x8000) {
+            tracking.expected = (record.seq + 1) & 0xffff;
+        }
+        
+        // Delayed by congestion or a reconnect past the end of its question
+        if (record.roundId && this.roundId && record.roundId !== this.roundId) {
+            console.warn(`${color} buzzer: ignoring seq ${record.seq} from round ${record.roundId} (current ${this.roundId})`);
+            return;
+        }
+        
+        const pressTime = this.getPressTime(color, record, arrivalTime);
+        
+        const age = record.ageMs ? `, queued ${record.ageMs} ms` : '';
+        const PHY_NAMES = { 1: '1M', 2: '2M', 4: 'Coded' };
+        const radio = record.phy ? `, ${PHY_NAMES[record.phy] || record.phy}` +
+            (record.rssi !== null ? ` ${record.rssi} dBm` : '') : '';
+        const reaction = record.reactionUs !== null ? `, reaction ${(record.reactionUs / 1000).toFixed(1)} ms` : '';
+        console.log(`${color} button ${record.pressed ? 'pressed' : 'released'} (seq ${record.seq}${age}${radio}${reaction})`);
+        if (record.pressed) {
+            this.handleButtonPress(color, pressTime, record.reactionUs);
+        }
+    }
+    
+    /**
+     * Ask the buzzer to re-send events starting at a sequence number
+     * @param {Object} buzzer - Connected buzzer object
+     * @param {number} fromSeq - First missing sequence number
+     */
+    async requestReplay(buzzer, fromSeq) {
+        try {
+            const request = new Uint8Array([0x01, fromSeq & 0xff, fromSeq >> 8]);
+            await buzzer.eventChar.writeValueWithoutResponse(request);
+        } catch (error) {
+            console.error(`Failed to request replay from ${buzzer.color} buzzer:`, error);
+        }
+    }
+    
+    /**
+     * Estimate when a button edge physically happened on the performance.now() timeline
+     * @param {string} color - 'green' or 'red'
+     * @param {Object} record - Decoded button event record
+     * @param {number} arrivalTime - performance.now() when the notification arrived
+     * @returns {number} Estimated edge time in performance.now() milliseconds
+     */
+    getPressTime(color, record, arrivalTime) {
+        const FLAG_TIMESTAMP = 0x01;
+        
+        if (!(record.flags & FLAG_TIMESTAMP)) {
+            // Pressed while the link was down: only the queueing age is known
+            return record.ageMs !== null ? arrivalTime - record.ageMs : arrivalTime;
+        }
+        if (record.connEvent > 0) {
+            return this.mapAnchoredTimestamp(
+                color,
+                record.connEvent,
+                record.anchorOffsetUs,
+                record.connInterval,
+                arrivalTime
+            );
+        }
+        return this.mapEdgeTimestamp(color, record.edgeUs, arrivalTime);
+    }
+    
+    /**
+     * Map a connection-event-anchored timestamp onto the performance.now() timeline
+     * 
+     * Anchor points are scheduled by this host's own Bluetooth controller, so
+     * event N starts at base + N * interval on the local timeline. A notification
+     * queued during event N can arrive no earlier than event N + 1, so the base
+     * is the smallest observed (arrival - (N + 1) * interval). This removes both
+     * the per-link connection interval skew and the buzzer crystal drift.
+     * @param {string} color - 'green' or 'red'
+     * @param {number} connEvent - Connection events started before the edge
+     * @param {number} offsetUs - Offset from that event's anchor point (us)
+     * @param {number} interval - Connection interval in 1.25 ms units
+     * @param {number} arrivalTime - performance.now() when the notification arrived
+     * @returns {number} Estimated edge time in performance.now() milliseconds
+     */
+    mapAnchoredTimestamp(color, connEvent, offsetUs, interval, arrivalTime) {
+        const DRIFT_ALLOWANCE = 100e-6;  // Controller vs system clock drift
+        const intervalMs = interval * 1.25;
+        let sync = this.anchorSync[color];
+        
+        // Event spacing changes with the interval, and the buzzer restarts its
+        // count when it leaves peripheral latency: start a new estimate
+        if (!sync || sync.interval !== interval || connEvent < sync.lastEvent) {
+            sync = { interval, base: Infinity, lastArrival: arrivalTime, lastEvent: 0 };
+            this.anchorSync[color] = sync;
+        }
+        sync.lastEvent = connEvent;
+        
+        const elapsed = arrivalTime - sync.lastArrival;
+        sync.lastArrival = arrivalTime;
+        sync.base = Math.min(arrivalTime - (connEvent + 1) * intervalMs,
+                             sync.base + elapsed * DRIFT_ALLOWANCE);
+        
+        return sync.base + connEvent * intervalMs + offsetUs / 1000;
+    }
+    
+    /**
+     * Map a firmware edge timestamp onto the performance.now() timeline
+     * 
+     * Each buzzer has its own free-running microsecond timer. The offset to the
+     * local clock is estimated as the smallest observed (arrival - edge), since
+     * link delays only ever add to it. The estimate is allowed to rise slowly
+     * to follow crystal drift between the two clocks.
+     * @param {string} color - 'green' or 'red'
+     * @param {number} edgeUs - 32-bit edge timestamp in microseconds
+     * @param {number} arrivalTime - performance.now() when the notification arrived
+     * @returns {number} Estimated press time in performance.now() milliseconds
+     */
+    mapEdgeTimestamp(color, edgeUs, arrivalTime) {
+        const DRIFT_ALLOWANCE = 100e-6;  // 100 ppm, covers two +/-40 ppm crystals
+        let sync = this.clockSync[color];
+        
+        if (!sync) {
+            sync = { lastEdgeUs: edgeUs, wraps: 0, offset: Infinity, lastArrival: arrivalTime };
+            this.clockSync[color] = sync;
+        }
+        
+        // Unwrap the 32-bit microsecond counter
+        if (edgeUs < sync.lastEdgeUs) {
+            sync.wraps++;
+        }
+        sync.lastEdgeUs = edgeUs;
+        const edgeMs = (sync.wraps * 4294967296 + edgeUs) / 1000;
+        
+        const elapsed = arrivalTime - sync.lastArrival;
+        sync.lastArrival = arrivalTime;
+        sync.offset = Math.min(arrivalTime - edgeMs, sync.offset + elapsed * DRIFT_ALLOWANCE);
+        
+        return edgeMs + sync.offset;
+    }
+    
     /**
      * Handle button press
+     * 
+     * Presses are held for a short arbitration window so that a press that
+     * happened first but arrived later over a slower link still wins.
      * @param {string} color - 'green' or 'red'
+     * @param {number} pressTime - Estimated press time (performance.now() ms)
+     * @param {number|null} reactionUs - Arm-to-press time measured on the buzzer
      */
-    handleButtonPress(color) {
+    handleButtonPress(color, pressTime = performance.now(), reactionUs = null) {
+        this.pendingPresses.push({ color, pressTime, reactionUs });
+        
+        if (this.arbitrationTimer) {
+            return;
+        }
+        
+        this.arbitrationTimer = setTimeout(() => {
+            const presses = this.pendingPresses.sort((a, b) => a.pressTime - b.pressTime);
+            this.pendingPresses = [];
+            this.arbitrationTimer = null;
+            
+            presses.forEach(press => this.dispatchButtonPress(press.color, press.pressTime, press.reactionUs));
+        }, this.arbitrationWindowMs);
+    }
+    
+    /**
+     * Notify button press callbacks
+     * @param {string} color - 'green' or 'red'
+     * @param {number} pressTime - Estimated press time (performance.now() ms)
+     * @param {number|null} reactionUs - Arm-to-press time measured on the buzzer
+     */
+    dispatchButtonPress(color, pressTime, reactionUs = null) {
         // Notify all registered callbacks
         this.buttonPressCallbacks.forEach(callback => {
             try {
-                callback(color);
+                callback(color, pressTime, reactionUs);
             } catch (error) {
                 console.error('Error in button press callback:', error);
             }
@@ -336,6 +1220,9 @@ class BuzzerManager {
             red: {
                 connected: this.connectionStatus.red === 'connected',
                 battery: this.batteryLevels.red
+            },
+            hub: {
+                connected: this.hub !== null
             }
         };
     }
@@ -362,6 +1249,10 @@ class BuzzerManager {
             promises.push(this.disconnectBuzzer('red'));
         }
         
+        if (this.hub) {
+            promises.push(this.disconnectHub());
+        }
+        
         await Promise.all(promises);
     }
     
@@ -376,6 +1267,26 @@ class BuzzerManager {
             { color: 'red', rgb: [255, 0, 0], duration: 300 }
         ];
         
+        // With the pattern engine each buzzer gets its whole timeline in one
+        // write (its own flashes, dark while the other one flashes)
+        if (this.greenBuzzer?.patternChar && this.redBuzzer?.patternChar) {
+            const timelines = { green: [], red: [] };
+            for (const step of pattern) {
+                for (const color of ['green', 'red']) {
+                    timelines[color].push({
+                        level: color === step.color ? 255 : 0,
+                        duration: step.duration
+                    });
+                    timelines[color].push({ level: 0, duration: 100 });
+                }
+            }
+            await Promise.all([
+                this.playLEDPattern('green', timelines.green, 1),
+                this.playLEDPattern('red', timelines.red, 1)
+            ]);
+            return;
+        }
+        
         for (const step of pattern) {
             await this.flashLED(step.color, step.rgb, step.duration);
             await new Promise(resolve => setTimeout(resolve, step.duration + 100));
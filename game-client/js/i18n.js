@@ -76,6 +76,7 @@ const translations = {
         'buzzer.connect': 'Connect',
         'buzzer.disconnect': 'Disconnect',
         'buzzer.test': 'Test Buzzers',
+        'buzzer.connectHub': 'Connect Hub',
         'buzzer.disconnectAll': 'Disconnect All',
     },
     fr: {
@@ -150,6 +151,7 @@ const translations = {
         'buzzer.connect': 'Connecter',
         'buzzer.disconnect': 'Déconnecter',
         'buzzer.test': 'Tester',
+        'buzzer.connectHub': 'Connecter le Hub',
         'buzzer.disconnectAll': 'Tout Déconnecter',
     }
 };